@@ -3,16 +3,52 @@
 
 #include "common.h"
 
-// Won't have actual audio but will support APU registers for compatibility
+class AudioOutput;
+
+struct ApuChannel
+{
+  bool enabled = false;
+  uint16 length = 0;
+  uint8 volume = 0;
+  uint8 envelope_timer = 0;
+  // duty step for the squares, wave ram index for channel 3
+  uint8 position = 0;
+  uint16 lfsr = 0x7FFF;
+  // time at which the frequency timer expires next
+  uint64 next_event = 0;
+  // current digital output 0-15
+  uint8 output = 0;
+};
+
+// Channels are only stepped when their frequency timer expires or a register
+// changes and every change of the output level becomes a band limited step
+// in the audio output. Without an output only the observable state is kept.
+// Nothing runs per cycle, state is caught up to the emulator clock whenever
+// a register is accessed, the frame sequencer is clocked or a frame ends.
 class APU
 {
 public:
   APU();
-  void tick();
+  void setClock(const uint64* clock) { m_clock = clock; }
   uint8 read(uint16 addr);
   void write(uint16 addr, uint8 val);
+  // called by the timer when bit 12 of the divider falls
+  void divTick();
+  // flushes everything synthesized so far to the output
+  void endFrame();
+  void setOutput(AudioOutput* output);
 
 private:
+  AudioOutput* m_output = nullptr;
+  const uint64* m_clock = nullptr;
+  // clock of the last catch up
+  uint64 m_time = 0;
+  ApuChannel m_channels[4];
+  uint8 m_frame_sequencer = 0;
+  bool m_sweep_enabled = false;
+  uint8 m_sweep_timer = 0;
+  uint16 m_shadow_frequency = 0;
+
   uint8 nr10 = 0x80; // Channel 1 Sweep
   uint8 nr11 = 0xBF; // Channel 1 Sound length/Wave pattern duty
   uint8 nr12 = 0xF3; // Channel 1 Volume Envelope
@@ -43,6 +79,29 @@ private:
   uint8 wave_ram[16] = { 0 };
 
   void initialize();
+  void catchUp();
+  void run(uint64 until);
+  void runChannel(uint8 channel, uint64 until);
+  void stepChannel(uint8 channel);
+  void setChannelOutput(uint8 channel, uint64 time, uint8 output);
+  uint8 channelOutput(uint8 channel) const;
+  // level of a square or wave channel at a pattern position
+  uint8 patternOutput(uint8 channel, uint8 position) const;
+  // steps until the level of a square or wave channel changes, 0 for never
+  uint32 stepsToNextChange(uint8 channel) const;
+  uint32 channelPeriod(uint8 channel) const;
+  bool isDacEnabled(uint8 channel) const;
+  uint8 envelopeRegister(uint8 channel) const;
+  uint8 controlRegister(uint8 channel) const;
+  void disableChannel(uint8 channel);
+  void trigger(uint8 channel);
+  // NRx1 length load, also allowed while the apu is powered off
+  void writeLength(uint8 channel, uint8 val);
+  void clockLength();
+  void clockEnvelope();
+  void clockSweep();
+  uint16 calculateSweep();
+  void mix(float& left, float& right) const;
   uint8 readNR10();
   uint8 readNR11();
   uint8 readNR12();
@@ -0,0 +1,106 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+constexpr uint32 GB_CLOCK_RATE = 4194304;
+// output rates the blip buffers and the frontend are sized for
+constexpr uint32 MinSampleRate = 8000;
+constexpr uint32 MaxSampleRate = 192000;
+
+// Lock free single producer single consumer ring of stereo int16 frames.
+// The emulator thread pushes and the audio callback pops.
+class AudioRing
+{
+public:
+  // capacity is rounded up to a power of two
+  explicit AudioRing(uint32 capacity_frames);
+  // returns how many frames fit, the rest are dropped
+  uint32 push(const int16* frames, uint32 count);
+  uint32 pop(int16* frames, uint32 count);
+  uint32 size() const;
+  uint32 capacity() const { return m_mask + 1; }
+
+private:
+  std::vector<int16> m_buffer;
+  uint32 m_mask = 0;
+  alignas(64) std::atomic<uint32> m_read{ 0 };
+  alignas(64) std::atomic<uint32> m_write{ 0 };
+};
+
+// Band limited synthesis in the style of blip_buf. Amplitude changes are
+// added as deltas at their exact clock time and spread with a windowed
+// sinc, reading integrates them back into samples.
+class BlipBuffer
+{
+public:
+  static constexpr int Taps = 16;
+  static constexpr int Phases = 32;
+
+  BlipBuffer(uint32 clock_rate, uint32 sample_rate, uint32 max_samples);
+  void clear(uint64 clock);
+  // only safe between frames, pending deltas keep their old positions
+  void setRates(uint32 clock_rate, double sample_rate);
+  void addDelta(uint64 clock, float delta);
+  uint32 samplesAvailable(uint64 clock) const;
+  void readSamples(float* out, uint32 count);
+
+private:
+  double m_factor;
+  double m_start_clock = 0;
+  float m_integrator = 0;
+  std::vector<float> m_deltas;
+};
+
+// Stereo blip buffers feeding the ring the frontend plays from
+class AudioOutput
+{
+public:
+  explicit AudioOutput(uint32 sample_rate);
+  uint32 getSampleRate() const { return m_sample_rate; }
+  AudioRing& getRing() { return m_ring; }
+  void clear(uint64 clock);
+  // stretches the output by ratio, used to steer the ring fill level
+  void setRateAdjust(double ratio);
+  void addDelta(uint64 clock, float left, float right);
+  // moves every finished sample up to clock into the ring
+  void endFrame(uint64 clock);
+
+private:
+  uint32 m_sample_rate;
+  BlipBuffer m_left;
+  BlipBuffer m_right;
+  // dc blocking high pass filter state
+  float m_capacitor[2] = { 0, 0 };
+  float m_charge_factor;
+  std::vector<float> m_left_samples;
+  std::vector<float> m_right_samples;
+  std::vector<int16> m_frames;
+  AudioRing m_ring;
+};
+
+// Writes stereo int16 frames as a wav file, or as raw pcm when the file
+// name does not end in .wav
+class AudioFileWriter
+{
+public:
+  AudioFileWriter(const std::string& path, uint32 sample_rate);
+  // patches the sizes into the wav header
+  ~AudioFileWriter();
+  bool isOpen() const { return m_file.is_open(); }
+  void write(const int16* frames, uint32 count);
+
+private:
+  void writeHeader();
+  std::ofstream m_file;
+  bool m_wav = false;
+  uint32 m_sample_rate;
+  uint32 m_frames_written = 0;
+};
+
+#endif // AUDIO_H
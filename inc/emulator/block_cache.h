@@ -0,0 +1,61 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+
+// An instruction of a block with its handler already looked up
+struct CachedInstruction
+{
+  const std::function<void()>* handler = nullptr;
+  uint16 addr = 0;
+  uint8 opcode = 0;
+};
+
+// Straight line code up to the first jump, call, return, rst or halt
+struct CodeBlock
+{
+  uint16 start = 0;
+  // one past the last byte of the last instruction
+  uint32 end = 0;
+  std::vector<CachedInstruction> instructions;
+  // opcodes and operands from start to end, fetched without the bus
+  std::vector<uint8> bytes;
+};
+
+// Decoded blocks keyed by bank and address. Every rom bank gets its own
+// keys so switching banks never throws anything away, blocks in ram are
+// dropped as soon as a page they cover is written to.
+class BlockCache
+{
+public:
+  // bank of blocks in wram and hram
+  static constexpr uint16 RamBank = 0xFFFF;
+  static constexpr uint8 MaxInstructions = 32;
+
+  static uint32 key(uint16 bank, uint16 addr) { return (bank << 16) | addr; }
+  static uint8 instructionLength(uint8 opcode);
+  static bool endsBlock(uint8 opcode);
+
+  // nullptr if the block wasn't decoded yet
+  CodeBlock* find(uint32 key);
+  CodeBlock* insert(uint32 key, CodeBlock&& block);
+  bool hasCode(uint16 addr) const { return m_code_pages[addr >> 8] != 0; }
+  // drops the ram blocks covering the page of addr
+  void invalidate(uint16 addr);
+  void clear();
+  uint64 size() const { return m_blocks.size(); }
+
+private:
+  void markPages(const CodeBlock& block);
+
+  std::unordered_map<uint32, CodeBlock> m_blocks;
+  // code in ram is rare, a list of keys is enough to invalidate it
+  std::vector<uint32> m_ram_blocks;
+  uint8 m_code_pages[256] = { 0 };
+};
+
+#endif // BLOCK_CACHE_H
@@ -2,25 +2,18 @@
 #define CARTRIDGE_H
 
 #include <memory>
+#include <vector>
 
 #include "common.h"
+#include "rom_image.h"
 
-typedef struct _header
+// Snapshot of the banking registers and cartridge ram
+struct MBC_State
 {
-  uint8 entry[4];
-  uint8 logo[0x30];
-  char title[16];
-  uint16 lic_code_new;
-  uint8 sgb_flag;
-  uint8 type;
-  uint8 rom_size;
-  uint8 ram_size;
-  uint8 dest_code;
-  uint8 lic_code;
-  uint8 version;
-  uint8 checksum;
-  uint16 global_checksum;
-} header;
+  std::vector<uint8> ram;
+  bool enabled_ram = false;
+  uint8 registers[4] = { 0 };
+};
 
 class MBC_Handler;
 
@@ -38,19 +31,31 @@ public:
 
   void write(uint16 address, uint8 val);
   uint8 read(uint16 address);
+  // see MBC_Handler::romBank
+  uint16 romBank(uint16 address) const;
+
+  void saveState(MBC_State& state) const;
+  void loadState(const MBC_State& state);
+  // persists battery backed ram if it changed since the last save
+  void flushSave();
+  // with saves disabled battery backed ram is never written to disk
+  void setSavesEnabled(bool enabled);
+  uint64 getRomHash() const { return m_rom->hash(); }
+  // directory battery saves are written to, defaults to the working one,
+  // an empty one keeps cartridges created afterwards from loading or
+  // writing saves
+  static void setSaveDirectory(const std::string& directory);
 
   bool isValidCartridge();
 
 private:
   std::string getDebugMsg();
-  bool checkData();
 
   std::string m_cartridge_location;
   bool m_valid = false;
   // cartridge data
-  std::unique_ptr<uint8[]> m_data;
-  header* m_cartridge_header;
-  uint32 m_cartridge_size;
+  std::shared_ptr<const RomImage> m_rom;
+  const header* m_cartridge_header = nullptr;
 
   std::unique_ptr<MBC_Handler> m_mbc_handler;
 };
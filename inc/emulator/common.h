@@ -1,6 +1,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <array>
 #include <cstdint>
 #include <fstream>
 #include <memory>
@@ -20,6 +21,12 @@ using int16 = std::int16_t;
 using int32 = std::int32_t;
 using int64 = std::int64_t;
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool HostLittleEndian = false;
+#else
+constexpr bool HostLittleEndian = true;
+#endif
+
 // Wram
 constexpr uint16 WramStart = 0xC000;
 constexpr uint16 WramEnd = 0xDFFF;
@@ -75,6 +82,15 @@ constexpr int GB_WIDTH = 160;
 constexpr int GB_HEIGHT = 144;
 const uint32 GB_COLORS[4] = { 0xFF9bbc0f, 0xFF8bac0f, 0xFF306230, 0xFF0f380f };
 
+// ARGB color of each of the 4 shades, from lightest to darkest
+using Palette = std::array<uint32, 4>;
+// green is GB_COLORS, also gray and pocket, nullptr for unknown names
+const Palette* findPalette(const std::string& name);
+void shadesToArgb(const uint8* shades,
+                  uint32* argb,
+                  uint32 count,
+                  const Palette& palette);
+
 enum class Interrupt
 {
   VBlank = 0x01,
@@ -373,9 +389,22 @@ enum class Component
 {
   CPU,
   PPU,
-  DMA
+  DMA,
+  Debug
 };
 
+// xxHash64 of the data
+uint64
+hash64(const void* data, uint64 size, uint64 seed = 0);
+
+// smallest power of two that is at least value
+uint32
+roundUpPowerOfTwo(uint32 value);
+
+// the whole text has to be a number that fits, no sign allowed
+bool
+parseNumber(const char* text, int base, uint64& value);
+
 template<typename T>
 T
 mask_n_bits(uint8 n, T value)
@@ -394,17 +423,14 @@ public:
     return logger;
   }
   void log(std::string msg);
+  // appends the log to a file instead of stdout, an empty path goes back
+  void setFile(const std::string& path);
 
 private:
-  Logger()
-  {
-    if (DEBUG_ENABLED) {
-      myfile.open("/home/nemanja/Desktop/debug_output.log", std::ios_base::app);
-    }
-  }
+  Logger() = default;
   ~Logger()
   {
-    if (DEBUG_ENABLED) {
+    if (myfile.is_open()) {
       myfile.flush();
       myfile.close();
     }
@@ -1,27 +1,82 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <array>
 #include <functional>
 
+#include "block_cache.h"
 #include "common.h"
 
+class Debugger;
 class MMU;
+class TraceRecorder;
+
+// One iteration of a busy wait loop, the reads of LY, STAT, IF and DIV it
+// made have to return the same values for the loop to keep spinning
+struct IdleLoopInfo
+{
+  static constexpr uint8 MaxReads = 4;
+  uint32 cycles = 0;
+  uint8 reads = 0;
+  uint16 addr[MaxReads] = { 0 };
+  uint8 value[MaxReads] = { 0 };
+};
 
 class CPU
 {
+  friend class Debugger;
   friend class MMU;
 
 public:
   CPU();
+  CPU(const CPU&) = delete;
+  // copies the cpu state, the current instruction is rebound to this cpu
+  CPU& operator=(const CPU& other);
   void tick(uint64 Tcycle);
   void setMMU(MMU* mmu) { this->mmu = mmu; }
+  // halted with no pending interrupt that would wake it up
+  bool isHalted() const { return halted && getInterrupts() == 0; }
+  void setIdleLoopDetection(bool enabled) { idle_detection = enabled; }
+  // true right after the head of a loop was decoded and the iteration that
+  // just ended wrote nothing, read only memory and LY, STAT, IF or DIV and
+  // started with the same registers as this one, an interrupt requested
+  // during the last instruction still has to be serviced first. Never
+  // while tracing or checking breakpoints, skipped iterations would be
+  // missing from the trace and never hit a breakpoint or finish a step
+  bool hasIdleLoop() const
+  {
+    return idle_found && getInterrupts() == 0 && tracer == nullptr &&
+           pc_breakpoints == nullptr;
+  }
+  const IdleLoopInfo& getIdleLoop() const { return idle_loop; }
+  void setDebugger(Debugger* debugger) { this->debugger = debugger; }
+  // a bit per address, the debugger is called before every instruction
+  // whose bit is set, nullptr when there is nothing to check
+  void setBreakpoints(const uint64* breakpoints)
+  {
+    pc_breakpoints = breakpoints;
+  }
+  // records the state before every instruction, nullptr stops tracing
+  void setTracer(TraceRecorder* tracer) { this->tracer = tracer; }
+  // look instructions up in decoded blocks instead of decoding every
+  // fetched opcode, on by default
+  void setBlockCaching(bool enabled);
+  // computes the flags of the alu ops the eager way as well and aborts as
+  // soon as the lazily computed ones differ, enabling it first checks every
+  // possible input once
+  void setFlagVerification(bool enabled);
 
 private:
-  enum class RegisterBits
+  // 8 bit registers in the order of the opcode encoding, without (hl)
+  enum class Reg8
   {
-    High,
-    Low,
-    Full
+    B,
+    C,
+    D,
+    E,
+    H,
+    L,
+    A
   };
 
   enum class FlagBits
@@ -32,6 +87,17 @@ private:
     Carry = 0x10
   };
 
+  // 8 bit alu op whose flags are only computed once F is read
+  enum class FlagOp
+  {
+    None,
+    Add,
+    Sub,
+    And,
+    Or,
+    Xor
+  };
+
   enum class Condition
   {
     Zero,
@@ -48,17 +114,42 @@ private:
     RequestEnable
   };
 
-  uint16 AF = 0x01B0;
-  uint16 BC = 0x0013;
-  uint16 DE = 0x00D8;
-  uint16 HL = 0x014D;
-  uint16 SP = 0xFFFE;
-  uint16 PC = 0x0100;
+  enum class InstructionKind
+  {
+    Opcode,
+    Prefix,
+    Interrupt
+  };
+
+  // the pairs share their bytes with register_bytes, set by initialize
+  union
+  {
+    struct
+    {
+      uint16 AF;
+      uint16 BC;
+      uint16 DE;
+      uint16 HL;
+      uint16 SP;
+      uint16 PC;
+    };
+    uint8 register_bytes[12];
+  };
 
   Ime ime = Ime::Disable;
   uint8 IER = 0;
   uint8 IFR = 0xE1;
 
+  // F in AF is out of date while there's a flag op
+  FlagOp flag_op = FlagOp::None;
+  uint8 flag_lhs = 0;
+  uint8 flag_rhs = 0;
+  uint8 flag_carry = 0;
+  uint8 flag_result = 0;
+  // the eager flags of the last op, only with verification on
+  bool verify_flags = false;
+  uint8 verify_f = 0;
+
   uint8 ioData = 0;
   uint8 highByte = 0;
   uint8 lowByte = 0;
@@ -67,76 +158,155 @@ private:
   bool halted = false;
   bool use_prefix_instruction = false;
   uint8 curr_opcode = 0;
-  std::function<void()> current_instruction;
+  InstructionKind curr_kind = InstructionKind::Opcode;
+  const std::function<void()>* current_instruction = nullptr;
+  std::function<void()> interrupt_instruction;
+  std::array<std::function<void()>, 256> prefix_instructions;
 
   MMU* mmu = nullptr;
+  Debugger* debugger = nullptr;
+  const uint64* pc_breakpoints = nullptr;
+  TraceRecorder* tracer = nullptr;
+
+  // busy wait loop detection, not part of the machine state
+  bool idle_detection = true;
+  bool idle_clean = false;
+  bool idle_found = false;
+  uint16 idle_head = 0;
+  uint16 idle_last_addr = 0;
+  uint32 idle_cycles = 0;
+  uint16 idle_registers[5] = { 0 };
+  Ime idle_ime = Ime::Disable;
+  IdleLoopInfo idle_reads;
+  IdleLoopInfo idle_loop;
+
+  // decoded blocks, not part of the machine state either
+  bool block_caching = true;
+  BlockCache block_cache;
+  CodeBlock* curr_block = nullptr;
+  uint32 curr_index = 0;
 
   void initialize();
   void cycle();
+  const std::function<void()>* decode(uint16 addr);
+  const CachedInstruction* findCached(uint16 addr);
+  CodeBlock* getBlock(uint16 addr);
+  std::unordered_map<uint8, std::function<void()>> bindOpcodes();
   std::function<void()> fetchPrefixInstruction(uint8 opcode);
+  template<Reg8 R>
+  std::function<void()> bindPrefix(uint8 opcode);
   void iduInc(uint16& reg, uint16 value = 1);
   void iduDec(uint16& reg, uint16 value = 1);
 
   void read(uint16 addr);
   void write(uint16 addr, uint8 val);
+  void traceInstruction(uint16 addr);
+  void trackIdleLoop();
+  void trackIdleRead(uint16 addr);
 
   void next();
 
-  void setRegister(uint16& reg, uint16 val, RegisterBits register_bits);
-  uint16 readRegister(uint16& reg, RegisterBits register_bits);
+  // the byte of R inside its pair, the lane is picked at compile time so
+  // 8 bit accesses are plain loads and stores
+  template<Reg8 R>
+  uint8& r8()
+  {
+    constexpr uint8 index = static_cast<uint8>(R);
+    constexpr uint8 pair = R == Reg8::A ? 0 : index / 2 + 1;
+    constexpr bool high = R == Reg8::A || index % 2 == 0;
+    return register_bytes[pair * 2 + (high == HostLittleEndian ? 1 : 0)];
+  }
 
   void setFlag(FlagBits flag, bool value);
   bool getFlag(FlagBits flag);
+  void setLazyFlags(FlagOp op, uint8 lhs, uint8 rhs, uint8 carry, uint8 result)
+  {
+    if (verify_flags) {
+      verify_f = eagerFlags(op, lhs, rhs, carry);
+    }
+    flag_op = op;
+    flag_lhs = lhs;
+    flag_rhs = rhs;
+    flag_carry = carry;
+    flag_result = result;
+  }
+  void materializeFlags();
+  // AF with up to date flags, without touching the lazy state
+  uint16 currentAF() const;
+  static uint8 lazyFlags(FlagOp op,
+                         uint8 lhs,
+                         uint8 rhs,
+                         uint8 carry,
+                         uint8 result);
+  static uint8 eagerFlags(FlagOp op, uint8 lhs, uint8 rhs, uint8 carry);
+  static bool verifyLazyFlags();
 
   bool checkCondition(Condition flag);
-  uint8 getInterrupts();
+  uint8 getInterrupts() const;
   void serviceInterrupt();
 
   // load instructions
-  void ld_r8_r8(uint16& regD,
-                RegisterBits regDB,
-                uint16& regS,
-                RegisterBits regSB);
-  void ld_r8_n8(uint16& regD, RegisterBits regB);
+  template<Reg8 D, Reg8 S>
+  void ld_r8_r8();
+  template<Reg8 D>
+  void ld_r8_n8();
   void ld_r16_n16(uint16& regD);
-  void ld_ar16_r8(uint16& regD, uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void ld_ar16_r8(uint16& regD);
   void ld_ar16_n8(uint16& regD);
-  void ld_r8_ar16(uint16& regD, RegisterBits regDB, uint16& regS);
-  void ld_a16_r8(uint16& regS, RegisterBits regSB);
-  void ldh_a8_r8(uint16& regS, RegisterBits regSB);
-  void ldh_ar8_r8(uint16& regD,
-                  RegisterBits regDB,
-                  uint16& regS,
-                  RegisterBits regSB);
-  void ld_r8_a16(uint16& regD, RegisterBits regDB);
-  void ldh_r8_a8(uint16& regD, RegisterBits regDB);
-  void ldh_r8_ar8(uint16& regD,
-                  RegisterBits regDB,
-                  uint16& regS,
-                  RegisterBits regSB);
-  void ld_ar16i_r8(uint16& regD, uint16& regS, RegisterBits regSB);
-  void ld_ar16d_r8(uint16& regD, uint16& regS, RegisterBits regSB);
-  void ld_r8_ar16i(uint16& regD, RegisterBits regDB, uint16& regS);
-  void ld_r8_ar16d(uint16& regD, RegisterBits regDB, uint16& regS);
+  template<Reg8 D>
+  void ld_r8_ar16(uint16& regS);
+  template<Reg8 S>
+  void ld_a16_r8();
+  template<Reg8 S>
+  void ldh_a8_r8();
+  template<Reg8 D, Reg8 S>
+  void ldh_ar8_r8();
+  template<Reg8 D>
+  void ld_r8_a16();
+  template<Reg8 D>
+  void ldh_r8_a8();
+  template<Reg8 D, Reg8 S>
+  void ldh_r8_ar8();
+  template<Reg8 S>
+  void ld_ar16i_r8(uint16& regD);
+  template<Reg8 S>
+  void ld_ar16d_r8(uint16& regD);
+  template<Reg8 D>
+  void ld_r8_ar16i(uint16& regS);
+  template<Reg8 D>
+  void ld_r8_ar16d(uint16& regS);
 
   // arithmetic instructions
-  void adc_r8(uint16& regS, RegisterBits regSB);
+  void alu_adc(uint8 val2);
+  template<Reg8 S>
+  void adc_r8();
   void adc_ar16(uint16& regS);
   void adc_n8();
-  void add_r8(uint16& regS, RegisterBits regSB);
+  void alu_add(uint8 val2);
+  template<Reg8 S>
+  void add_r8();
   void add_ar16(uint16& regS);
   void add_n8();
-  void cp_r8(uint16& regS, RegisterBits regSB);
+  void alu_cp(uint8 val2);
+  template<Reg8 S>
+  void cp_r8();
   void cp_ar16(uint16& regS);
   void cp_n8();
-  void dec_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void dec_r8();
   void dec_ar16(uint16& regS);
-  void inc_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void inc_r8();
   void inc_ar16(uint16& regS);
-  void sbc_r8(uint16& regS, RegisterBits regSB);
+  void alu_sbc(uint8 val2);
+  template<Reg8 S>
+  void sbc_r8();
   void sbc_ar16(uint16& regS);
   void sbc_n8();
-  void sub_r8(uint16& regS, RegisterBits regSB);
+  void alu_sub(uint8 val2);
+  template<Reg8 S>
+  void sub_r8();
   void sub_ar16(uint16& regS);
   void sub_n8();
   void add_r16_r16(uint16& regD, uint16& regS);
@@ -144,45 +314,63 @@ private:
   void inc_r16(uint16& regS);
 
   // bitwise logic instructions
-  void and_r8(uint16& regS, RegisterBits regSB);
+  void alu_and(uint8 val2);
+  template<Reg8 S>
+  void and_r8();
   void and_ar16(uint16& regS);
   void and_n8();
   void cpl();
-  void or_r8(uint16& regS, RegisterBits regSB);
+  void alu_or(uint8 val2);
+  template<Reg8 S>
+  void or_r8();
   void or_ar16(uint16& regS);
   void or_n8();
-  void xor_r8(uint16& regS, RegisterBits regSB);
+  void alu_xor(uint8 val2);
+  template<Reg8 S>
+  void xor_r8();
   void xor_ar16(uint16& regS);
   void xor_n8();
 
   // bit manipulation instructions
-  void bit_r8(uint16& regS, RegisterBits regSB, uint8 bit);
+  void alu_bit(uint8 val, uint8 bit);
+  template<Reg8 S>
+  void bit_r8(uint8 bit);
   void bit_ar16(uint16& regS, uint8 bit);
-  void res_r8(uint16& regS, RegisterBits regSB, uint8 bit);
+  template<Reg8 S>
+  void res_r8(uint8 bit);
   void res_ar16(uint16& regS, uint8 bit);
-  void set_r8(uint16& regS, RegisterBits regSB, uint8 bit);
+  template<Reg8 S>
+  void set_r8(uint8 bit);
   void set_ar16(uint16& regS, uint8 bit);
 
   // bit shift instructions
-  void rl_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void rl_r8();
   void rl_ar16(uint16& regS);
   void rla();
-  void rlc_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void rlc_r8();
   void rlc_ar16(uint16& regS);
   void rlca();
-  void rr_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void rr_r8();
   void rr_ar16(uint16& regS);
   void rra();
-  void rrc_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void rrc_r8();
   void rrc_ar16(uint16& regS);
   void rrca();
-  void sla_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void sla_r8();
   void sla_ar16(uint16& regS);
-  void sra_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void sra_r8();
   void sra_ar16(uint16& regS);
-  void srl_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void srl_r8();
   void srl_ar16(uint16& regS);
-  void swap_r8(uint16& regS, RegisterBits regSB);
+  template<Reg8 S>
+  void swap_r8();
   void swap_ar16(uint16& regS);
 
   // jumps and subroutine instructions
@@ -223,688 +411,8 @@ private:
                                                   0xE4, 0xEB, 0xEC, 0xED,
                                                   0xF4, 0xFC, 0xFD };
 
-  const std::unordered_map<uint8, std::function<void()>> opcode_map = {
-    { 0x00, std::bind(&CPU::nop, this) },
-    { 0x01, std::bind(&CPU::ld_r16_n16, this, std::ref(BC)) },
-    { 0x02,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(BC),
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x03, std::bind(&CPU::inc_r16, this, std::ref(BC)) },
-    { 0x04, std::bind(&CPU::inc_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0x05, std::bind(&CPU::dec_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0x06, std::bind(&CPU::ld_r8_n8, this, std::ref(BC), RegisterBits::High) },
-    { 0x07, std::bind(&CPU::rlca, this) },
-    { 0x08, std::bind(&CPU::ld_a16_sp, this) },
-    { 0x09, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(BC)) },
-    { 0x0A,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(BC)) },
-    { 0x0B, std::bind(&CPU::dec_r16, this, std::ref(BC)) },
-    { 0x0C, std::bind(&CPU::inc_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0x0D, std::bind(&CPU::dec_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0x0E, std::bind(&CPU::ld_r8_n8, this, std::ref(BC), RegisterBits::Low) },
-    { 0x0F, std::bind(&CPU::rrca, this) },
-
-    { 0x10, std::bind(&CPU::stop, this) },
-    { 0x11, std::bind(&CPU::ld_r16_n16, this, std::ref(DE)) },
-    { 0x12,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(DE),
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x13, std::bind(&CPU::inc_r16, this, std::ref(DE)) },
-    { 0x14, std::bind(&CPU::inc_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0x15, std::bind(&CPU::dec_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0x16, std::bind(&CPU::ld_r8_n8, this, std::ref(DE), RegisterBits::High) },
-    { 0x17, std::bind(&CPU::rla, this) },
-    { 0x18, std::bind(&CPU::jr_a8, this) },
-    { 0x19, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(DE)) },
-    { 0x1A,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(DE)) },
-    { 0x1B, std::bind(&CPU::dec_r16, this, std::ref(DE)) },
-    { 0x1C, std::bind(&CPU::inc_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0x1D, std::bind(&CPU::dec_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0x1E, std::bind(&CPU::ld_r8_n8, this, std::ref(DE), RegisterBits::Low) },
-    { 0x1F, std::bind(&CPU::rra, this) },
-
-    { 0x20, std::bind(&CPU::jr_cc_a8, this, Condition::NotZero) },
-    { 0x21, std::bind(&CPU::ld_r16_n16, this, std::ref(HL)) },
-    { 0x22,
-      std::bind(&CPU::ld_ar16i_r8,
-                this,
-                std::ref(HL),
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x23, std::bind(&CPU::inc_r16, this, std::ref(HL)) },
-    { 0x24, std::bind(&CPU::inc_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0x25, std::bind(&CPU::dec_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0x26, std::bind(&CPU::ld_r8_n8, this, std::ref(HL), RegisterBits::High) },
-    { 0x27, std::bind(&CPU::daa, this) },
-    { 0x28, std::bind(&CPU::jr_cc_a8, this, Condition::Zero) },
-    { 0x29, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(HL)) },
-    { 0x2A,
-      std::bind(&CPU::ld_r8_ar16i,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(HL)) },
-    { 0x2B, std::bind(&CPU::dec_r16, this, std::ref(HL)) },
-    { 0x2C, std::bind(&CPU::inc_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0x2D, std::bind(&CPU::dec_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0x2E, std::bind(&CPU::ld_r8_n8, this, std::ref(HL), RegisterBits::Low) },
-    { 0x2F, std::bind(&CPU::cpl, this) },
-
-    { 0x30, std::bind(&CPU::jr_cc_a8, this, Condition::NotCarry) },
-    { 0x31, std::bind(&CPU::ld_r16_n16, this, std::ref(SP)) },
-    { 0x32,
-      std::bind(&CPU::ld_ar16d_r8,
-                this,
-                std::ref(HL),
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x33, std::bind(&CPU::inc_r16, this, std::ref(SP)) },
-    { 0x34, std::bind(&CPU::inc_ar16, this, std::ref(HL)) },
-    { 0x35, std::bind(&CPU::dec_ar16, this, std::ref(HL)) },
-    { 0x36, std::bind(&CPU::ld_ar16_n8, this, std::ref(HL)) },
-    { 0x37, std::bind(&CPU::scf, this) },
-    { 0x38, std::bind(&CPU::jr_cc_a8, this, Condition::Carry) },
-    { 0x39, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(SP)) },
-    { 0x3A,
-      std::bind(&CPU::ld_r8_ar16d,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(HL)) },
-    { 0x3B, std::bind(&CPU::dec_r16, this, std::ref(SP)) },
-    { 0x3C, std::bind(&CPU::inc_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0x3D, std::bind(&CPU::dec_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0x3E, std::bind(&CPU::ld_r8_n8, this, std::ref(AF), RegisterBits::High) },
-    { 0x3F, std::bind(&CPU::ccf, this) },
-
-    { 0x40,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x41,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x42,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x43,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x44,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x45,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x46,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(HL)) },
-    { 0x47,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::High,
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x48,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x49,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x4A,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x4B,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x4C,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x4D,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x4E,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(HL)) },
-    { 0x4F,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(AF),
-                RegisterBits::High) },
-
-    { 0x50,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x51,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x52,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x53,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x54,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x55,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x56,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(HL)) },
-    { 0x57,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::High,
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x58,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x59,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x5A,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x5B,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x5C,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x5D,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x5E,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(HL)) },
-    { 0x5F,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(DE),
-                RegisterBits::Low,
-                std::ref(AF),
-                RegisterBits::High) },
-
-    { 0x60,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x61,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x62,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x63,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x64,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x65,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x66,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(HL)) },
-    { 0x67,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::High,
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x68,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x69,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x6A,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x6B,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x6C,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x6D,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x6E,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(HL)) },
-    { 0x6F,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(HL),
-                RegisterBits::Low,
-                std::ref(AF),
-                RegisterBits::High) },
-
-    { 0x70,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(HL),
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x71,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(HL),
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x72,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(HL),
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x73,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(HL),
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x74,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(HL),
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x75,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(HL),
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x76, std::bind(&CPU::halt, this) },
-    { 0x77,
-      std::bind(&CPU::ld_ar16_r8,
-                this,
-                std::ref(HL),
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0x78,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::High) },
-    { 0x79,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0x7A,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::High) },
-    { 0x7B,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(DE),
-                RegisterBits::Low) },
-    { 0x7C,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::High) },
-    { 0x7D,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(HL),
-                RegisterBits::Low) },
-    { 0x7E,
-      std::bind(&CPU::ld_r8_ar16,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(HL)) },
-    { 0x7F,
-      std::bind(&CPU::ld_r8_r8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(AF),
-                RegisterBits::High) },
-
-    { 0x80, std::bind(&CPU::add_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0x81, std::bind(&CPU::add_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0x82, std::bind(&CPU::add_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0x83, std::bind(&CPU::add_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0x84, std::bind(&CPU::add_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0x85, std::bind(&CPU::add_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0x86, std::bind(&CPU::add_ar16, this, std::ref(HL)) },
-    { 0x87, std::bind(&CPU::add_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0x88, std::bind(&CPU::adc_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0x89, std::bind(&CPU::adc_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0x8A, std::bind(&CPU::adc_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0x8B, std::bind(&CPU::adc_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0x8C, std::bind(&CPU::adc_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0x8D, std::bind(&CPU::adc_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0x8E, std::bind(&CPU::adc_ar16, this, std::ref(HL)) },
-    { 0x8F, std::bind(&CPU::adc_r8, this, std::ref(AF), RegisterBits::High) },
-
-    { 0x90, std::bind(&CPU::sub_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0x91, std::bind(&CPU::sub_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0x92, std::bind(&CPU::sub_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0x93, std::bind(&CPU::sub_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0x94, std::bind(&CPU::sub_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0x95, std::bind(&CPU::sub_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0x96, std::bind(&CPU::sub_ar16, this, std::ref(HL)) },
-    { 0x97, std::bind(&CPU::sub_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0x98, std::bind(&CPU::sbc_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0x99, std::bind(&CPU::sbc_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0x9A, std::bind(&CPU::sbc_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0x9B, std::bind(&CPU::sbc_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0x9C, std::bind(&CPU::sbc_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0x9D, std::bind(&CPU::sbc_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0x9E, std::bind(&CPU::sbc_ar16, this, std::ref(HL)) },
-    { 0x9F, std::bind(&CPU::sbc_r8, this, std::ref(AF), RegisterBits::High) },
-
-    { 0xA0, std::bind(&CPU::and_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0xA1, std::bind(&CPU::and_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0xA2, std::bind(&CPU::and_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0xA3, std::bind(&CPU::and_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0xA4, std::bind(&CPU::and_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0xA5, std::bind(&CPU::and_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0xA6, std::bind(&CPU::and_ar16, this, std::ref(HL)) },
-    { 0xA7, std::bind(&CPU::and_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0xA8, std::bind(&CPU::xor_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0xA9, std::bind(&CPU::xor_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0xAA, std::bind(&CPU::xor_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0xAB, std::bind(&CPU::xor_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0xAC, std::bind(&CPU::xor_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0xAD, std::bind(&CPU::xor_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0xAE, std::bind(&CPU::xor_ar16, this, std::ref(HL)) },
-    { 0xAF, std::bind(&CPU::xor_r8, this, std::ref(AF), RegisterBits::High) },
-
-    { 0xB0, std::bind(&CPU::or_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0xB1, std::bind(&CPU::or_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0xB2, std::bind(&CPU::or_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0xB3, std::bind(&CPU::or_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0xB4, std::bind(&CPU::or_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0xB5, std::bind(&CPU::or_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0xB6, std::bind(&CPU::or_ar16, this, std::ref(HL)) },
-    { 0xB7, std::bind(&CPU::or_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0xB8, std::bind(&CPU::cp_r8, this, std::ref(BC), RegisterBits::High) },
-    { 0xB9, std::bind(&CPU::cp_r8, this, std::ref(BC), RegisterBits::Low) },
-    { 0xBA, std::bind(&CPU::cp_r8, this, std::ref(DE), RegisterBits::High) },
-    { 0xBB, std::bind(&CPU::cp_r8, this, std::ref(DE), RegisterBits::Low) },
-    { 0xBC, std::bind(&CPU::cp_r8, this, std::ref(HL), RegisterBits::High) },
-    { 0xBD, std::bind(&CPU::cp_r8, this, std::ref(HL), RegisterBits::Low) },
-    { 0xBE, std::bind(&CPU::cp_ar16, this, std::ref(HL)) },
-    { 0xBF, std::bind(&CPU::cp_r8, this, std::ref(AF), RegisterBits::High) },
-
-    { 0xC0, std::bind(&CPU::ret_cc, this, Condition::NotZero) },
-    { 0xC1, std::bind(&CPU::pop_r16, this, std::ref(BC)) },
-    { 0xC2, std::bind(&CPU::jp_cc_a16, this, Condition::NotZero) },
-    { 0xC3, std::bind(&CPU::jp_a16, this) },
-    { 0xC4, std::bind(&CPU::call_cc, this, Condition::NotZero) },
-    { 0xC5, std::bind(&CPU::push_r16, this, std::ref(BC)) },
-    { 0xC6, std::bind(&CPU::add_n8, this) },
-    { 0xC7, std::bind(&CPU::rst, this) },
-    { 0xC8, std::bind(&CPU::ret_cc, this, Condition::Zero) },
-    { 0xC9, std::bind(&CPU::ret, this) },
-    { 0xCA, std::bind(&CPU::jp_cc_a16, this, Condition::Zero) },
-    { 0xCB, std::bind(&CPU::prefix_cb, this) },
-    { 0xCC, std::bind(&CPU::call_cc, this, Condition::Zero) },
-    { 0xCD, std::bind(&CPU::call_a16, this) },
-    { 0xCE, std::bind(&CPU::adc_n8, this) },
-    { 0xCF, std::bind(&CPU::rst, this) },
-
-    { 0xD0, std::bind(&CPU::ret_cc, this, Condition::NotCarry) },
-    { 0xD1, std::bind(&CPU::pop_r16, this, std::ref(DE)) },
-    { 0xD2, std::bind(&CPU::jp_cc_a16, this, Condition::NotCarry) },
-    { 0xD4, std::bind(&CPU::call_cc, this, Condition::NotCarry) },
-    { 0xD5, std::bind(&CPU::push_r16, this, std::ref(DE)) },
-    { 0xD6, std::bind(&CPU::sub_n8, this) },
-    { 0xD7, std::bind(&CPU::rst, this) },
-    { 0xD8, std::bind(&CPU::ret_cc, this, Condition::Carry) },
-    { 0xD9, std::bind(&CPU::reti, this) },
-    { 0xDA, std::bind(&CPU::jp_cc_a16, this, Condition::Carry) },
-    { 0xDC, std::bind(&CPU::call_cc, this, Condition::Carry) },
-    { 0xDE, std::bind(&CPU::sbc_n8, this) },
-    { 0xDF, std::bind(&CPU::rst, this) },
-
-    { 0xE0,
-      std::bind(&CPU::ldh_a8_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0xE1, std::bind(&CPU::pop_r16, this, std::ref(HL)) },
-    { 0xE2,
-      std::bind(&CPU::ldh_ar8_r8,
-                this,
-                std::ref(BC),
-                RegisterBits::Low,
-                std::ref(AF),
-                RegisterBits::High) },
-    { 0xE5, std::bind(&CPU::push_r16, this, std::ref(HL)) },
-    { 0xE6, std::bind(&CPU::and_n8, this) },
-    { 0xE7, std::bind(&CPU::rst, this) },
-    { 0xE8, std::bind(&CPU::add_sp_e8, this) },
-    { 0xE9, std::bind(&CPU::jp_r16, this, std::ref(HL)) },
-    { 0xEA,
-      std::bind(&CPU::ld_a16_r8, this, std::ref(AF), RegisterBits::High) },
-    { 0xEE, std::bind(&CPU::xor_n8, this) },
-    { 0xEF, std::bind(&CPU::rst, this) },
-
-    { 0xF0,
-      std::bind(&CPU::ldh_r8_a8, this, std::ref(AF), RegisterBits::High) },
-    { 0xF1, std::bind(&CPU::pop_r16, this, std::ref(AF)) },
-    { 0xF2,
-      std::bind(&CPU::ldh_r8_ar8,
-                this,
-                std::ref(AF),
-                RegisterBits::High,
-                std::ref(BC),
-                RegisterBits::Low) },
-    { 0xF3, std::bind(&CPU::di, this) },
-    { 0xF5, std::bind(&CPU::push_r16, this, std::ref(AF)) },
-    { 0xF6, std::bind(&CPU::or_n8, this) },
-    { 0xF7, std::bind(&CPU::rst, this) },
-    { 0xF8, std::bind(&CPU::ld_hl_sp_e8, this) },
-    { 0xF9, std::bind(&CPU::ld_r16_r16, this, std::ref(SP), std::ref(HL)) },
-    { 0xFA,
-      std::bind(&CPU::ld_r8_a16, this, std::ref(AF), RegisterBits::High) },
-    { 0xFB, std::bind(&CPU::ei, this) },
-    { 0xFE, std::bind(&CPU::cp_n8, this) },
-    { 0xFF, std::bind(&CPU::rst, this) }
-  };
+  const std::unordered_map<uint8, std::function<void()>> opcode_map =
+    bindOpcodes();
 };
 
 #endif // CPU_H
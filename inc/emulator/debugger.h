@@ -0,0 +1,79 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+class CPU;
+class MMU;
+
+// Breakpoints, watchpoints and a console to inspect the machine with.
+// Nothing is checked while none are set: the cpu only tests a bitmap of
+// breakpoint addresses when one is published and the mmu only looks at a
+// table of watched pages when a watchpoint exists. When the emulation
+// stops the console runs on stdin inside the hook, so the emulator loop
+// never has to check whether it should stop.
+class Debugger
+{
+public:
+  enum Access : uint8
+  {
+    Read = 0x01,
+    Write = 0x02
+  };
+
+  struct Watchpoint
+  {
+    uint16 start;
+    uint16 end;
+    uint8 access;
+  };
+
+  Debugger(CPU* cpu, MMU* mmu);
+  ~Debugger();
+
+  void addBreakpoint(uint16 addr);
+  void removeBreakpoint(uint16 addr);
+  // end is inclusive, access is a mask of Access
+  void addWatchpoint(uint16 start, uint16 end, uint8 access);
+  void removeWatchpoint(size_t index);
+  // stops before the next instruction
+  void requestBreak() { step(1); }
+  // stops after count instructions
+  void step(uint32 count);
+
+  // called by the cpu before an instruction whose bit is set
+  void onInstruction(uint16 addr);
+  // called by the mmu for cpu accesses to a watched page
+  void onAccess(uint16 addr, uint8 val, Access access);
+
+  // text of the instruction at addr, length gets its size in bytes
+  std::string disassemble(uint16 addr, uint8* length = nullptr) const;
+  // address of an io register name like LCDC, -1 if unknown
+  static int32 ioRegister(const std::string& name);
+
+private:
+  void publish();
+  void console(uint16 pc);
+  bool runCommand(const std::string& line, uint16 pc);
+  void printRegisters(uint16 pc) const;
+  void printMemory(uint16 addr, uint32 length) const;
+  void printBreakpoints() const;
+  uint8 peek(uint16 addr) const;
+
+  CPU* m_cpu;
+  MMU* m_mmu;
+  // a bit per address
+  uint64 m_breakpoints[0x10000 / 64] = { 0 };
+  uint32 m_breakpoint_count = 0;
+  std::vector<Watchpoint> m_watchpoints;
+  // Access mask of every 256 byte page
+  uint8 m_watched_pages[0x100] = { 0 };
+  uint32 m_steps = 0;
+  std::string m_hit;
+  std::string m_last_command;
+};
+
+#endif // DEBUGGER_H
@@ -5,14 +5,46 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "apu.h"
+#include "audio.h"
 #include "cartridge.h"
 #include "cpu.h"
+#include "debugger.h"
 #include "joypad.h"
+#include "link.h"
 #include "mmu.h"
+#include "movie.h"
 #include "ppu.h"
+#include "serial.h"
 #include "timer.h"
+#include "trace.h"
+#include "video.h"
+
+// Full copy of the emulated machine, restorable into any emulator running
+// the same cartridge
+struct EmulatorSnapshot
+{
+  CPU cpu;
+  PPU ppu;
+  Timer timer;
+  APU apu;
+  Joypad joypad;
+  Serial serial;
+  MMU mmu{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+  MBC_State mbc;
+  uint64 Tcycles = 0;
+  uint64 frame_end = 0;
+};
+
+// What a test rom reported over the serial port
+enum class TestResult
+{
+  None,
+  Passed,
+  Failed
+};
 
 class Emulator
 {
@@ -20,14 +52,82 @@ public:
   Emulator(std::string file);
   ~Emulator();
 
+  static constexpr uint64 TicksPerFrame = 70224;
+
   void cycleFrame();
+  // runs for the given number of T-cycles, finishing every frame that ends
+  // on the way
+  void runFor(uint64 ticks);
   void run();
   bool isValid();
   void mainLoop();
+  // runs without window or audio device as fast as emulation allows, with
+  // stop_on_result it returns as soon as the serial output says Passed or
+  // Failed
+  TestResult runHeadless(uint64 frames, bool stop_on_result = false);
+
+  void saveSnapshot(EmulatorSnapshot& snapshot) const;
+  void loadSnapshot(const EmulatorSnapshot& snapshot);
+  void setPressedButtons(uint8 pressed);
+  uint8 peek(uint16 addr);
+  const uint8* getShades() const { return m_ppu->LCD_SHADES; }
+  // the shades in ARGB, converted with the palette when asked for
+  const uint32* getFramebuffer();
+  void setPalette(const Palette& palette);
+  uint64 frameHash() const;
+  // starts synthesizing audio, every finished frame is pushed to the ring
+  AudioOutput* enableAudioOutput(uint32 sample_rate);
+  // pace mainLoop by the audio ring fill level instead of sleeping
+  void setAudioSync(bool enabled) { m_audio_sync = enabled; }
+  // skip iterations of busy wait loops, on by default
+  void setIdleLoopDetection(bool enabled);
+  // run instructions from decoded blocks, on by default
+  void setBlockCaching(bool enabled);
+  // checks the lazily computed cpu flags against the eager ones, slow
+  void setFlagVerification(bool enabled);
+  // copy OAM DMA sources in one go instead of a byte per M-cycle
+  void setFastOamDma(bool enabled);
+  // write battery backed ram to the save file, on by default
+  void setSavesEnabled(bool enabled);
+  // every byte sent over the serial port goes to the sinks, they have to
+  // outlive the emulator or be removed
+  void addSerialSink(SerialSink* sink);
+  void removeSerialSink(SerialSink* sink);
+  // attaches a debugger, F1 in mainLoop stops at the next instruction and
+  // opens its console on stdin
+  Debugger* enableDebugger();
+  // plugs one end of a link cable into the serial port, nullptr unplugs it
+  void connectLink(LinkPort* port);
+  // records the input of mainLoop into a movie written when it exits, has
+  // to be called before the first frame
+  void recordMovie(const std::string& path);
+  // plays a movie recorded from power on as fast as possible, false as soon
+  // as a frame doesn't match the recording
+  bool replayMovie(const Movie& movie);
+  // renders the audio of runHeadless to a wav or raw pcm file
+  bool recordAudio(const std::string& path, uint32 sample_rate);
+  // records every finished frame to a video file, see VideoRecorder
+  bool recordVideo(const std::string& path);
+  // writes the cpu state before every instruction to a binary trace, see
+  // tools/gb_trace.cpp to turn it into text
+  bool recordTrace(const std::string& path);
+  // frames the video writer couldn't keep up with
+  uint64 droppedVideoFrames() const;
   std::thread* m_gameThread = nullptr;
 
 private:
+  void tick();
+  void finishFrame();
+  uint64 ticksToNextEvent(uint64 limit);
+  bool skipHaltedTicks(uint64 limit);
+  void skipIdleLoop(uint64 limit);
+  void finishBootVBlank();
   void HandleSdlEvent(SDL_Event& event);
+  // waits until the audio ring drained to the target level, false when
+  // there is no audio or the device stopped draining it
+  bool syncToAudio();
+  static TestResult parseTestResult(const std::string& output);
+  static void audioCallback(void* userdata, Uint8* stream, int len);
   std::unique_ptr<Cartridge> m_cartridge;
   std::unique_ptr<CPU> m_cpu;
   std::unique_ptr<PPU> m_ppu;
@@ -35,7 +135,24 @@ private:
   std::unique_ptr<Timer> m_timer;
   std::unique_ptr<MMU> m_mmu;
   std::unique_ptr<Joypad> m_joypad;
+  std::unique_ptr<Serial> m_serial;
+  std::unique_ptr<Debugger> m_debugger;
+  std::vector<SerialSink*> m_serial_sinks;
+  LinkPort* m_link = nullptr;
+  std::unique_ptr<AudioOutput> m_audio;
+  std::unique_ptr<AudioFileWriter> m_audio_writer;
+  std::unique_ptr<VideoRecorder> m_video;
+  std::unique_ptr<TraceRecorder> m_trace;
+  std::unique_ptr<Movie> m_movie;
+  std::string m_movie_path;
   uint64 m_Tcycles = 0;
+  uint64 m_frame_end = 0;
+  uint64 m_frames = 0;
+  Palette m_palette{ GB_COLORS[0], GB_COLORS[1], GB_COLORS[2], GB_COLORS[3] };
+  uint32 m_framebuffer[GB_HEIGHT * GB_WIDTH];
+  // T-cycle the framebuffer was converted at
+  uint64 m_framebuffer_ticks = UINT64_MAX;
+  bool m_audio_sync = false;
 };
 
 #endif // EMULATOR_H
@@ -25,6 +25,9 @@ public:
   void write(uint8 val);
   uint8 read();
   void handleButton(JoypadInputs button, bool released);
+  // presses every button in the mask and releases all others
+  void setPressedButtons(uint8 pressed);
+  uint8 getPressedButtons() const { return ~buttons; }
   void setMMU(MMU* mmu) { this->mmu = mmu; }
 
 private:
@@ -0,0 +1,105 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <atomic>
+#include <vector>
+
+#include "common.h"
+
+class Emulator;
+class Serial;
+
+struct LinkMessage
+{
+  enum class Type : uint8
+  {
+    // serial registers of the sender at the end of a quantum
+    State,
+    // the sender clocked out a byte on its internal clock
+    Transfer
+  };
+  uint64 quantum;
+  Type type;
+  uint8 data;
+  uint8 control;
+};
+
+// Lock free single producer single consumer queue of link messages
+class LinkChannel
+{
+public:
+  // capacity is rounded up to a power of two
+  explicit LinkChannel(uint32 capacity);
+  bool push(const LinkMessage& message);
+  // the oldest message without removing it
+  bool peek(LinkMessage& message) const;
+  void pop();
+
+private:
+  std::vector<LinkMessage> m_buffer;
+  uint32 m_mask = 0;
+  alignas(64) std::atomic<uint32> m_read{ 0 };
+  alignas(64) std::atomic<uint32> m_write{ 0 };
+};
+
+// The end of the cable plugged into one emulator. Messages only take
+// effect on the other side at the start of its next quantum, which keeps
+// the result independent of how the two threads get scheduled.
+class LinkPort
+{
+public:
+  void attach(Serial* serial) { m_serial = serial; }
+  // called by the serial port whenever SB or SC change
+  void publish(uint8 sb, uint8 sc);
+  // sends a byte on the internal clock, returns what the other end had in
+  // SB if it was waiting on the external clock and 0xFF otherwise
+  uint8 exchange(uint8 data);
+
+private:
+  friend class LinkCable;
+  void connect(LinkChannel* incoming, LinkChannel* outgoing);
+  void deliver(uint64 quantum);
+  void endQuantum();
+
+  Serial* m_serial = nullptr;
+  LinkChannel* m_incoming = nullptr;
+  LinkChannel* m_outgoing = nullptr;
+  uint64 m_quantum = 0;
+  uint8 m_sb = 0;
+  uint8 m_sc = 0x7E;
+  bool m_state_changed = true;
+  // what the other end had at the end of its last delivered quantum
+  uint8 m_peer_sb = 0xFF;
+  uint8 m_peer_sc = 0x7E;
+};
+
+// Connects the serial ports of two emulators and runs them on separate
+// threads. Both run a quantum of T-cycles and wait for each other before
+// starting the next one, so a byte arrives at most a quantum late but
+// always at the same point of emulation.
+class LinkCable
+{
+public:
+  static constexpr uint32 DefaultQuantum = 1024;
+
+  LinkCable(Emulator& first, Emulator& second, uint32 quantum = DefaultQuantum);
+  ~LinkCable();
+  void run(uint64 frames);
+
+private:
+  void runSide(int side, uint64 ticks);
+
+  Emulator* m_emulators[2];
+  uint32 m_quantum_ticks;
+  // channel i carries messages into emulator i
+  LinkChannel m_channels[2];
+  LinkPort m_ports[2];
+  // quanta each side has finished
+  struct alignas(64) Progress
+  {
+    std::atomic<uint64> quanta{ 0 };
+  };
+  Progress m_done[2];
+};
+
+#endif // LINK_H
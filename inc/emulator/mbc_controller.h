@@ -1,41 +1,81 @@
 #ifndef MBC_CONTROLLER_H
 #define MBC_CONTROLLER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "cartridge.h"
 #include "common.h"
 
 class MBC_Handler
 {
 public:
-  MBC_Handler(uint8* data, header* header);
+  MBC_Handler(const RomImage* rom);
   virtual ~MBC_Handler();
   void write(uint16 address, uint8 val);
   uint8 read(uint16 address);
+  virtual void saveState(MBC_State& state) const;
+  virtual void loadState(const MBC_State& state);
+  // bank mapped at a rom address, reads of the same bank and address always
+  // return the same byte
+  virtual uint16 romBank(uint16 address) const;
+  // hands battery backed ram to the save thread if it changed, the file
+  // is written in the background
+  void flush();
+  void setSavesEnabled(bool enabled) { m_saves_enabled = enabled; }
 
   static std::unique_ptr<MBC_Handler> CreateHandler(Cartridge* cartridge);
+  static void setSaveDirectory(const std::string& directory);
 
 protected:
-  uint8* m_data = nullptr;
+  const uint8* m_data = nullptr;
   std::unique_ptr<uint8[]> m_ram = nullptr;
   uint32 m_ram_size = 0;
   uint32 m_rom_size = 0;
-  header* m_header = nullptr;
+  const header* m_header = nullptr;
+  uint64 m_rom_hash = 0;
   bool m_has_battery = false;
   bool m_enabled_ram = false;
+  bool m_ram_dirty = false;
+  bool m_saves_enabled = true;
+  // the ram as it is in the save file, nothing has to be written as long
+  // as the ram matches it
+  std::vector<uint8> m_saved_ram;
 
   virtual void write_rom(uint16 address, uint8 val) = 0;
   virtual void write_ram(uint16 address, uint8 val) = 0;
   virtual uint8 read_rom(uint16 address) = 0;
   virtual uint8 read_ram(uint16 address) = 0;
-  void save();
+  void initializeRam(uint32 size);
+  void setRamEnabled(bool enabled);
+  std::string getSavePath() const;
   void load();
+
+private:
+  static std::string save_directory;
+
+  // fsync can take long, saves are written by a thread started with the
+  // first one
+  std::thread m_save_thread;
+  std::mutex m_save_lock;
+  std::condition_variable m_save_cv;
+  std::vector<uint8> m_pending_save;
+  bool m_save_pending = false;
+  bool m_stop_saving = false;
+  std::atomic<bool> m_save_failed{ false };
+
+  void saveLoop();
+  bool save(const std::vector<uint8>& ram);
 };
 
 class NoMBC_Handler : public MBC_Handler
 {
 public:
-  NoMBC_Handler(uint8* data, header* header)
-    : MBC_Handler(data, header)
+  NoMBC_Handler(const RomImage* rom)
+    : MBC_Handler(rom)
   {
   }
 
@@ -49,7 +89,10 @@ protected:
 class MBC1_Handler : public MBC_Handler
 {
 public:
-  MBC1_Handler(uint8* data, header* header);
+  MBC1_Handler(const RomImage* rom);
+  virtual void saveState(MBC_State& state) const override;
+  virtual void loadState(const MBC_State& state) override;
+  virtual uint16 romBank(uint16 address) const override;
 
 protected:
   virtual void write_rom(uint16 address, uint8 val) override;
@@ -58,8 +101,6 @@ protected:
   virtual uint8 read_ram(uint16 address) override;
 
 private:
-  bool checkIsMBC1M();
-
   uint8 m_mode = 0;
   uint8 m_low_banking_bits = 1;
   uint8 m_high_banking_bits = 0;
@@ -69,7 +110,10 @@ private:
 class MBC2_Handler : public MBC_Handler
 {
 public:
-  MBC2_Handler(uint8* data, header* header);
+  MBC2_Handler(const RomImage* rom);
+  virtual void saveState(MBC_State& state) const override;
+  virtual void loadState(const MBC_State& state) override;
+  virtual uint16 romBank(uint16 address) const override;
 
 protected:
   virtual void write_rom(uint16 address, uint8 val) override;
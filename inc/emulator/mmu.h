@@ -5,8 +5,10 @@
 #include "cartridge.h"
 #include "common.h"
 #include "cpu.h"
+#include "debugger.h"
 #include "joypad.h"
 #include "ppu.h"
+#include "serial.h"
 #include "timer.h"
 
 class MMU
@@ -17,11 +19,29 @@ public:
       PPU* ppu,
       Timer* timer,
       APU* apu,
-      Joypad* joypad);
+      Joypad* joypad,
+      Serial* serial);
+  // copies the memory state, component pointers are kept as they are
+  MMU& operator=(const MMU& other);
   uint8 read(uint16 addr, Component component);
   void write(uint16 addr, uint8 val, Component component);
   void setDmaActive(bool active) { dma_active = active; }
+  bool isDmaActive() const { return dma_active; }
+  // cpu reads of rom, wram and hram return what is in memory and nothing
+  // else notices them
+  bool hasQuietReads() const
+  {
+    return !dma_active && watched_pages == nullptr;
+  }
+  // copies a whole DMA source page into oam, false if the page isn't plain
+  // memory and has to be transferred a byte at a time
+  bool copyDmaSource(uint8 page);
   void requestInterrupt(Interrupt interrupt);
+  uint16 romBank(uint16 addr) const { return cartridge->romBank(addr); }
+  void setDebugger(Debugger* debugger) { this->debugger = debugger; }
+  // Debugger::Access mask of every page, cpu accesses to pages with a bit
+  // set go to the debugger, nullptr when nothing is watched
+  void setWatchedPages(const uint8* pages) { watched_pages = pages; }
 
 private:
   uint8 read_rom(uint16 addr, Component component);
@@ -45,12 +65,13 @@ private:
   Timer* timer;
   APU* apu;
   Joypad* joypad;
+  Serial* serial;
+  Debugger* debugger = nullptr;
+  const uint8* watched_pages = nullptr;
   uint8 wram[WramSize] = { 0 };
   uint8 vram[VramSize] = { 0 };
   uint8 oam[OamSize] = { 0 };
   uint8 hram[HramSize] = { 0 };
-  uint8 sb = 0;
-  uint8 sc = 0x7E;
 
   bool dma_active = false;
 };
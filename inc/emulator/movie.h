@@ -0,0 +1,41 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+// Joypad input of every frame of a session started at power on, together
+// with the hash of the framebuffer each frame produced when it was recorded
+// and the cartridge ram it started with. On disk the input is stored as
+// runs of frames with the same buttons pressed.
+class Movie
+{
+public:
+  Movie() = default;
+  explicit Movie(uint64 rom_hash)
+    : m_rom_hash(rom_hash)
+  {
+  }
+
+  // pressed uses the layout of JoypadInputs
+  void addFrame(uint8 pressed, uint64 frame_hash);
+  uint64 frames() const { return m_buttons.size(); }
+  uint8 buttons(uint64 frame) const { return m_buttons[frame]; }
+  uint64 frameHash(uint64 frame) const { return m_hashes[frame]; }
+  uint64 romHash() const { return m_rom_hash; }
+  void setStartRam(const std::vector<uint8>& ram) { m_start_ram = ram; }
+  const std::vector<uint8>& startRam() const { return m_start_ram; }
+
+  bool save(const std::string& path) const;
+  bool load(const std::string& path);
+
+private:
+  uint64 m_rom_hash = 0;
+  std::vector<uint8> m_start_ram;
+  std::vector<uint8> m_buttons;
+  std::vector<uint64> m_hashes;
+};
+
+#endif // MOVIE_H
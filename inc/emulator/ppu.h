@@ -52,10 +52,20 @@ public:
   void tick(uint64 Tcycle);
   void tick_dma(uint64 Tcycle);
   PpuMode getMode() const { return mode; }
+  // ticks until the next mode, LY or STAT change that can be skipped
+  // without running tick, 0 during pixel transfer or DMA
+  uint32 idleTicks() const;
+  void skipIdleTicks(uint32 ticks);
+  // copy the whole DMA source page when the transfer starts, the bus stays
+  // locked for the usual 160 M-cycles
+  void setFastDma(bool enabled) { fast_dma = enabled; }
   uint8 read(uint16 addr) const;
   void write(uint16 addr, uint8 val);
   void setMMU(MMU* mmu) { this->mmu = mmu; }
-  uint32 LCD_PIXELS[GB_HEIGHT * GB_WIDTH];
+  // hash of the last finished frame, taken when VBlank starts
+  uint64 getFrameHash() const { return frame_hash; }
+  // shade 0-3 of every pixel, turned into colors only by whoever shows them
+  uint8 LCD_SHADES[GB_HEIGHT * GB_WIDTH];
 
 private:
   enum class FetcherState
@@ -122,7 +132,15 @@ private:
   uint8 oam_tile_data0;
   uint8 oam_tile_data1;
 
+  uint64 frame_hash = 0;
+  void updateFrameHash();
+
   uint8 dma_transferes = 0;
+  bool fast_dma = true;
+  // oam already holds the rest of the current transfer, the source can't
+  // change underneath it since the cpu is locked out of every page that
+  // copyDmaSource accepts until the transfer ends
+  bool dma_copied = false;
   void PixelFetcher();
   void SpriteFetcher();
   bool CanPushPixelsToScreen();
@@ -0,0 +1,60 @@
+#ifndef ROM_IMAGE_H
+#define ROM_IMAGE_H
+
+#include <memory>
+#include <string>
+
+#include "common.h"
+
+typedef struct _header
+{
+  uint8 entry[4];
+  uint8 logo[0x30];
+  char title[16];
+  uint16 lic_code_new;
+  uint8 sgb_flag;
+  uint8 type;
+  uint8 rom_size;
+  uint8 ram_size;
+  uint8 dest_code;
+  uint8 lic_code;
+  uint8 version;
+  uint8 checksum;
+  uint16 global_checksum;
+} header;
+
+// Immutable memory mapped rom, validated once and shared by every
+// cartridge in the process that loads the same file
+class RomImage
+{
+public:
+  ~RomImage();
+  RomImage(const RomImage&) = delete;
+  RomImage& operator=(const RomImage&) = delete;
+
+  // Returns the cached image for the file if it is still loaded and
+  // unchanged, otherwise maps and validates it. nullptr on failure.
+  static std::shared_ptr<const RomImage> load(const std::string& location);
+
+  const uint8* data() const { return m_data; }
+  uint32 size() const { return m_size; }
+  uint64 hash() const { return m_hash; }
+  const header* getHeader() const { return &m_header; }
+  bool hasValidHeader() const { return m_valid_header; }
+  bool isMBC1M() const { return m_is_mbc1m; }
+
+private:
+  RomImage(const uint8* data, uint32 size, uint64 hash);
+  bool checkData() const;
+  bool checkIsMBC1M() const;
+
+  const uint8* m_data = nullptr;
+  uint32 m_size = 0;
+  uint64 m_hash = 0;
+  // copy of the header with the title null terminated
+  header m_header;
+  bool m_valid_header = false;
+  bool m_is_mbc1m = false;
+};
+
+#endif // ROM_IMAGE_H
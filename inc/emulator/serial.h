@@ -0,0 +1,86 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+class LinkPort;
+class MMU;
+class Timer;
+
+// Receives every byte the game sends over the serial port
+class SerialSink
+{
+public:
+  virtual ~SerialSink() = default;
+  virtual void receive(uint8 byte) = 0;
+};
+
+class SerialBufferSink : public SerialSink
+{
+public:
+  void receive(uint8 byte) override { m_output.push_back(byte); }
+  const std::string& getOutput() const { return m_output; }
+  void clear() { m_output.clear(); }
+
+private:
+  std::string m_output;
+};
+
+// Writes to a file or to stdout when the path is "-"
+class SerialFileSink : public SerialSink
+{
+public:
+  explicit SerialFileSink(const std::string& path);
+  ~SerialFileSink();
+  void receive(uint8 byte) override;
+  bool isOpen() const { return m_file != nullptr; }
+
+private:
+  std::FILE* m_file = nullptr;
+};
+
+// Transfers on the internal clock complete on their own, with nothing
+// connected the game receives 0xFF. Ones on the external clock only
+// complete when the other end of a link cable sends a byte. Like the timer
+// it is evaluated when accessed or when the end of the transfer is due.
+class Serial
+{
+public:
+  Serial() = default;
+  uint8 read(uint16 addr);
+  void write(uint16 addr, uint8 val);
+  void setMMU(MMU* mmu) { this->mmu = mmu; }
+  void setTimer(Timer* timer) { this->timer = timer; }
+  void setClock(const uint64* clock) { this->clock = clock; }
+  void setSinks(const std::vector<SerialSink*>* sinks) { this->sinks = sinks; }
+  void setLink(LinkPort* link);
+  // the other end clocked out a byte, completes a transfer waiting on the
+  // external clock
+  void receive(uint8 data);
+  // finishes the transfer if it ended before until
+  void catchUp(uint64 until);
+  // clock on which the running transfer ends
+  uint64 nextEvent() const { return transfer_end; }
+
+private:
+  MMU* mmu = nullptr;
+  Timer* timer = nullptr;
+  const uint64* clock = nullptr;
+  const std::vector<SerialSink*>* sinks = nullptr;
+  LinkPort* link = nullptr;
+  void startTransfer();
+  void finishTransfer();
+  void sendToSinks(uint8 byte);
+  uint8 shiftedBits() const;
+  uint8 sb = 0;
+  uint8 sc = 0x7E;
+  uint8 outgoing = 0;
+  uint64 first_shift = 0;
+  uint64 transfer_end = UINT64_MAX;
+};
+
+#endif // SERIAL_H
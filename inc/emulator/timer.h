@@ -3,16 +3,30 @@
 
 #include "common.h"
 
+class APU;
 class MMU;
 
+// DIV and TIMA are only evaluated when they are accessed or when the next
+// event is due, the timer interrupt or a falling edge of DIV bit 4 for the
+// APU. Runs of M-cycles without an edge are skipped in one step, giving the
+// same results as evaluating every M-cycle.
 class Timer
 {
 public:
   Timer();
-  void M_tick();
   void write(uint16 addr, uint8 val);
-  uint8 read(uint16 addr) const;
+  uint8 read(uint16 addr);
   void setMMU(MMU* mmu) { this->mmu = mmu; }
+  void setAPU(APU* apu) { this->apu = apu; }
+  void setClock(const uint64* clock) { this->clock = clock; }
+  // runs every M-cycle that ended before until
+  void catchUp(uint64 until);
+  // clock of the M-cycle with the next interrupt or APU edge
+  uint64 nextEvent() const { return next_event; }
+  // clock of the M-cycle on which the DIV register changes next
+  uint64 nextDivChange();
+  // the full 16 bit counter DIV is the upper half of
+  uint16 systemCounter();
 
 private:
   enum class State
@@ -22,7 +36,14 @@ private:
     Reload
   };
   MMU* mmu = nullptr;
+  APU* apu = nullptr;
+  const uint64* clock = nullptr;
   void initialize();
+  void M_tick();
+  void advance(uint64 ticks);
+  void scheduleNextEvent();
+  uint64 ticksToFallingEdge() const;
+  uint64 ticksToApuEdge() const;
   void reset_div();
   void write_tima(uint8 val);
   void write_tma(uint8 val);
@@ -33,12 +54,16 @@ private:
   uint8 read_tac() const;
   void tima_tick();
   void falling_edge();
+  void apu_edge(uint16 old_div);
   uint16 div;
   uint8 tima;
   uint8 tma;
   uint8 tac;
   bool prev_bit;
   State state;
+  // clock up to which every M-cycle has been run
+  uint64 synced;
+  uint64 next_event;
 };
 
 #endif // TIMER_H
@@ -0,0 +1,85 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdio>
+#include <string>
+
+#include "common.h"
+#include "writer_ring.h"
+
+// State of the cpu before an instruction, what Gameboy Doctor prints
+struct TraceRecord
+{
+  // T-cycle the instruction started at
+  uint64 cycle;
+  uint16 pc;
+  uint16 sp;
+  uint8 a;
+  uint8 f;
+  uint8 b;
+  uint8 c;
+  uint8 d;
+  uint8 e;
+  uint8 h;
+  uint8 l;
+  // the 4 bytes at pc
+  uint8 mem[4];
+};
+
+// Collects trace records in a WriterRing that writes them to disk. Records
+// are stored as they are in memory after a small header, little endian on
+// every host we build for. A trace with holes is useless for comparing
+// against other emulators, so when the ring is full the emulator waits for
+// the writer instead of dropping records.
+class TraceRecorder
+{
+public:
+  explicit TraceRecorder(const std::string& path,
+                         uint32 ring_records = 1 << 16);
+  ~TraceRecorder();
+  bool isOpen() const { return m_file != nullptr; }
+  void setClock(const uint64* clock) { m_clock = clock; }
+  uint64 now() const { return *m_clock; }
+
+  // the slot the next record goes into, valid until push
+  TraceRecord& next()
+  {
+    if (!m_ring.hasSpace()) {
+      waitForSpace();
+    }
+    return m_ring.next();
+  }
+  void push() { m_ring.push(); }
+  uint64 recordsWritten() const { return m_ring.written(); }
+
+  static constexpr char Magic[4] = { 'G', 'B', 'T', 'R' };
+  static constexpr uint32 Version = 1;
+
+private:
+  // records are small, waking the writer for each one would cost more
+  // than writing it
+  static constexpr uint32 WakeInterval = 4096;
+
+  void waitForSpace();
+
+  std::FILE* m_file = nullptr;
+  std::string m_path;
+  const uint64* m_clock = nullptr;
+  uint64 m_stalls = 0;
+  WriterRing<TraceRecord> m_ring;
+};
+
+// Reads the records of a trace file back
+class TraceReader
+{
+public:
+  explicit TraceReader(const std::string& path);
+  ~TraceReader();
+  bool isOpen() const { return m_file != nullptr; }
+  bool read(TraceRecord& record);
+
+private:
+  std::FILE* m_file = nullptr;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,76 @@
+#ifndef VEC_EMULATOR_H
+#define VEC_EMULATOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "emulator.h"
+
+enum class ObservationFormat
+{
+  Shades, // 1 byte per pixel holding the shade index 0-3
+  ARGB    // 4 bytes per pixel, same layout as Emulator::getFramebuffer
+};
+
+// Owns N emulators running the same cartridge and steps all of them
+// in parallel on a fixed pool of worker threads
+class VecEmulator
+{
+public:
+  VecEmulator(std::string file, uint32 num_envs, uint32 num_threads = 0);
+  ~VecEmulator();
+
+  bool isValid();
+  uint32 size() const { return m_num_envs; }
+  Emulator& at(uint32 env) { return m_envs[env]; }
+  static uint32 observationSize(ObservationFormat format);
+
+  // addresses read into the ram buffer after every step
+  void setWatchedAddresses(const std::vector<uint16>& addresses);
+  // applied at the start of the next step
+  void setPressedButtons(uint32 env, uint8 pressed);
+  // observations has to hold size() * observationSize(format) bytes and
+  // ram size() * number of watched addresses bytes
+  void step(uint32 frames,
+            uint8* observations,
+            ObservationFormat format,
+            uint8* ram = nullptr);
+
+  void saveSnapshot(uint32 env, EmulatorSnapshot& snapshot) const;
+  void loadSnapshot(uint32 env, const EmulatorSnapshot& snapshot);
+  // restores the state the environment had after creation
+  void reset(uint32 env);
+
+private:
+  void workerLoop();
+  void runJobs();
+  void stepEnv(uint32 env);
+
+  uint32 m_num_envs = 0;
+  Emulator* m_envs = nullptr;
+  std::vector<uint8> m_buttons;
+  std::vector<uint16> m_watched_addresses;
+  EmulatorSnapshot m_initial_snapshot;
+
+  // parameters of the step currently being executed
+  uint32 m_frames = 0;
+  uint8* m_observations = nullptr;
+  ObservationFormat m_format = ObservationFormat::Shades;
+  uint8* m_ram = nullptr;
+
+  std::vector<std::thread> m_workers;
+  std::mutex m_lock;
+  std::condition_variable m_work_cv;
+  std::condition_variable m_done_cv;
+  uint64 m_generation = 0;
+  bool m_stop = false;
+  std::atomic<uint32> m_next_env{ 0 };
+  std::atomic<uint32> m_remaining{ 0 };
+};
+
+#endif // VEC_EMULATOR_H
@@ -0,0 +1,64 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "writer_ring.h"
+
+// Records finished frames to a file through a WriterRing. The shades of a
+// frame are copied into the ring and only turned into colors by the
+// writer, when it falls behind and the ring is full new frames are dropped
+// instead of waiting for the disk.
+// The format follows the file name:
+//   .y4m  YUV4MPEG2, 4:4:4
+//   .gbv  frame deltas, every frame is a list of varint runs alternating
+//         between unchanged pixels and changed pixels followed by their
+//         rgb values, lossless and mostly a few bytes per frame
+//   else  raw rgb24, 160x144 at 262144/4389 fps
+class VideoRecorder
+{
+public:
+  enum class Format
+  {
+    Raw,
+    Y4M,
+    Delta
+  };
+
+  VideoRecorder(const std::string& path,
+                const Palette& palette,
+                uint32 ring_frames = 64);
+  ~VideoRecorder();
+  bool isOpen() const { return m_file.is_open(); }
+  // shades in the layout of PPU::LCD_SHADES, never blocks
+  void pushFrame(const uint8* shades);
+  uint64 framesWritten() const { return m_ring.written(); }
+  uint64 framesDropped() const { return m_dropped; }
+
+  static constexpr uint32 FrameSize = GB_WIDTH * GB_HEIGHT;
+
+private:
+  using Frame = std::array<uint8, FrameSize>;
+
+  void writeFrame(const uint8* shades);
+  void writeY4M(const uint32* pixels);
+  void writeDelta(const uint32* pixels);
+  void writeVarint(uint32 value);
+
+  std::ofstream m_file;
+  std::string m_path;
+  Format m_format = Format::Raw;
+  Palette m_palette;
+  uint64 m_dropped = 0;
+  // writer thread state
+  std::vector<uint32> m_pixels;
+  std::vector<uint32> m_previous;
+  std::vector<uint8> m_output;
+  // last so the writer stops before the state it uses goes away
+  WriterRing<Frame> m_ring;
+};
+
+#endif // VIDEO_H
@@ -0,0 +1,125 @@
+#ifndef WRITER_RING_H
+#define WRITER_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+// Lock free single producer ring drained by a background writer thread.
+// The emulator thread fills next() and publishes it with push(), the writer
+// hands runs of published slots that are contiguous in memory to the drain
+// callback. Stopping drains everything that was pushed before it.
+template<typename T>
+class WriterRing
+{
+public:
+  using Drain = std::function<void(const T* slots, uint32 count)>;
+
+  // capacity is rounded up to a power of two. The writer is woken every
+  // wake_interval pushes and polls in between, so a missed notify only
+  // delays it. A slot is given back after at most max_batch others.
+  explicit WriterRing(uint32 capacity,
+                      uint32 wake_interval = 1,
+                      uint32 max_batch = UINT32_MAX)
+    : m_max_batch(std::max<uint32>(max_batch, 1))
+  {
+    capacity = roundUpPowerOfTwo(std::max<uint32>(capacity, 2));
+    m_slots.resize(capacity);
+    m_mask = capacity - 1;
+    m_wake_mask = roundUpPowerOfTwo(wake_interval) - 1;
+  }
+  ~WriterRing() { stop(); }
+
+  void start(Drain drain)
+  {
+    m_drain = std::move(drain);
+    m_writer = std::thread(&WriterRing::writerLoop, this);
+  }
+  // returns once everything pushed so far went through the drain
+  void stop()
+  {
+    if (!m_writer.joinable()) {
+      return;
+    }
+    m_stop.store(true, std::memory_order_release);
+    m_wake.notify_one();
+    m_writer.join();
+  }
+
+  // false while the writer still holds the slot next() would return
+  bool hasSpace()
+  {
+    uint32 write = m_write.load(std::memory_order_relaxed);
+    if (write - m_read_cache > m_mask) {
+      m_read_cache = m_read.load(std::memory_order_acquire);
+    }
+    return write - m_read_cache <= m_mask;
+  }
+  // only valid after hasSpace returned true, until push
+  T& next()
+  {
+    return m_slots[m_write.load(std::memory_order_relaxed) & m_mask];
+  }
+  void push()
+  {
+    uint32 write = m_write.load(std::memory_order_relaxed) + 1;
+    m_write.store(write, std::memory_order_release);
+    if ((write & m_wake_mask) == 0) {
+      m_wake.notify_one();
+    }
+  }
+  // for a producer that waits on hasSpace instead of dropping
+  void wake() { m_wake.notify_one(); }
+  uint64 written() const { return m_written.load(); }
+
+private:
+  void writerLoop()
+  {
+    while (true) {
+      // stop is set after the last push, once it is seen the ring holds
+      // everything that will ever be written
+      bool stopping = m_stop.load(std::memory_order_acquire);
+      uint32 read = m_read.load(std::memory_order_relaxed);
+      uint32 write = m_write.load(std::memory_order_acquire);
+      if (read != write) {
+        // up to the end of the ring in one go, the rest on the next pass
+        uint32 start = read & m_mask;
+        uint32 count = std::min(
+          { write - read, m_mask + 1 - start, m_max_batch });
+        m_drain(&m_slots[start], count);
+        m_read.store(read + count, std::memory_order_release);
+        m_written.fetch_add(count, std::memory_order_relaxed);
+        continue;
+      }
+      if (stopping) {
+        break;
+      }
+      std::unique_lock<std::mutex> lock(m_wake_mutex);
+      m_wake.wait_for(lock, std::chrono::milliseconds(5));
+    }
+  }
+
+  std::vector<T> m_slots;
+  uint32 m_mask = 0;
+  uint32 m_wake_mask = 0;
+  uint32 m_max_batch;
+  // last read index seen by the producer
+  uint32 m_read_cache = 0;
+  alignas(64) std::atomic<uint32> m_read{ 0 };
+  alignas(64) std::atomic<uint32> m_write{ 0 };
+  std::atomic<uint64> m_written{ 0 };
+  std::atomic<bool> m_stop{ false };
+  std::mutex m_wake_mutex;
+  std::condition_variable m_wake;
+  Drain m_drain;
+  std::thread m_writer;
+};
+
+#endif // WRITER_RING_H
@@ -1,5 +1,22 @@
 #include "apu.h"
 
+#include "audio.h"
+
+namespace {
+
+const uint8 DUTY_PATTERNS[4][8] = { { 0, 0, 0, 0, 0, 0, 0, 1 },
+                                    { 1, 0, 0, 0, 0, 0, 0, 1 },
+                                    { 1, 0, 0, 0, 0, 1, 1, 1 },
+                                    { 0, 1, 1, 1, 1, 1, 1, 0 } };
+
+// right shift applied to wave samples for each output level
+const uint8 WAVE_SHIFTS[4] = { 4, 0, 1, 2 };
+
+// all four channels at full volume on both sides stay inside an int16
+const float VOLUME_SCALE = 64.0f;
+
+}
+
 APU::APU()
 {
   initialize();
@@ -38,17 +55,384 @@ APU::initialize()
   for (int i = 0; i < 16; i++) {
     wave_ram[i] = 0;
   }
+
+  for (ApuChannel& channel : m_channels) {
+    channel = ApuChannel();
+  }
+  // the boot rom leaves channel 1 on with its envelope run down
+  m_channels[0].enabled = true;
+  m_frame_sequencer = 0;
+  m_sweep_enabled = false;
+  m_sweep_timer = 0;
+  m_shadow_frequency = 0;
+}
+
+void
+APU::setOutput(AudioOutput* output)
+{
+  m_output = output;
+  m_time = *m_clock;
+  if (m_output) {
+    m_output->clear(m_time);
+  }
+}
+
+void
+APU::endFrame()
+{
+  catchUp();
+  if (m_output) {
+    m_output->endFrame(m_time);
+  }
+}
+
+void
+APU::divTick()
+{
+  if (!(nr52 & 0x80)) {
+    return;
+  }
+  catchUp();
+  if (!(m_frame_sequencer & 1)) {
+    clockLength();
+  }
+  if (m_frame_sequencer == 2 || m_frame_sequencer == 6) {
+    clockSweep();
+  }
+  if (m_frame_sequencer == 7) {
+    clockEnvelope();
+  }
+  m_frame_sequencer = (m_frame_sequencer + 1) & 7;
+}
+
+void
+APU::catchUp()
+{
+  m_time = *m_clock;
+  run(m_time);
+}
+
+void
+APU::run(uint64 until)
+{
+  for (uint8 channel = 0; channel < 4; channel++) {
+    runChannel(channel, until);
+  }
 }
 
 void
-APU::tick()
+APU::runChannel(uint8 channel, uint64 until)
 {
-  // TODO
+  ApuChannel& ch = m_channels[channel];
+  if (!ch.enabled || ch.next_event > until) {
+    return;
+  }
+  uint32 period = channelPeriod(channel);
+  if (period == 0) {
+    // frozen noise channel
+    ch.next_event = until + 1;
+    return;
+  }
+  if (m_output == nullptr) {
+    // nobody is listening, only keep the timer phase
+    uint64 steps = (until - ch.next_event) / period + 1;
+    ch.next_event += steps * period;
+    ch.position = (ch.position + steps) & (channel == 2 ? 31 : 7);
+    return;
+  }
+  if (channel == 3) {
+    while (ch.next_event <= until) {
+      stepChannel(channel);
+      setChannelOutput(channel, ch.next_event, channelOutput(channel));
+      ch.next_event += period;
+    }
+    return;
+  }
+  // nothing else changes the level before the next catch up, so the timer
+  // can jump straight to the step where the pattern changes it
+  uint8 mask = channel == 2 ? 31 : 7;
+  while (ch.next_event <= until) {
+    uint64 remaining = (until - ch.next_event) / period + 1;
+    uint32 steps = stepsToNextChange(channel);
+    if (steps == 0 || steps > remaining) {
+      ch.next_event += remaining * period;
+      ch.position = (ch.position + remaining) & mask;
+      return;
+    }
+    ch.next_event += (steps - 1) * period;
+    ch.position = (ch.position + steps) & mask;
+    setChannelOutput(channel, ch.next_event, channelOutput(channel));
+    ch.next_event += period;
+  }
+}
+
+uint32
+APU::stepsToNextChange(uint8 channel) const
+{
+  const ApuChannel& ch = m_channels[channel];
+  uint8 mask = channel == 2 ? 31 : 7;
+  for (uint32 steps = 1; steps <= mask + 1u; steps++) {
+    if (patternOutput(channel, (ch.position + steps) & mask) != ch.output) {
+      return steps;
+    }
+  }
+  return 0;
+}
+
+void
+APU::stepChannel(uint8 channel)
+{
+  ApuChannel& ch = m_channels[channel];
+  switch (channel) {
+    case 0:
+    case 1:
+      ch.position = (ch.position + 1) & 7;
+      break;
+    case 2:
+      ch.position = (ch.position + 1) & 31;
+      break;
+    default: {
+      uint16 bit = (ch.lfsr ^ (ch.lfsr >> 1)) & 1;
+      ch.lfsr = (ch.lfsr >> 1) | (bit << 14);
+      if (nr43 & 0x08) {
+        ch.lfsr = (ch.lfsr & ~0x40) | (bit << 6);
+      }
+      break;
+    }
+  }
+}
+
+void
+APU::setChannelOutput(uint8 channel, uint64 time, uint8 output)
+{
+  ApuChannel& ch = m_channels[channel];
+  if (ch.output == output) {
+    return;
+  }
+  float delta = (static_cast<int>(output) - ch.output) * VOLUME_SCALE;
+  ch.output = output;
+  if (m_output == nullptr) {
+    return;
+  }
+  float left = (nr51 & (0x10 << channel)) ? delta * (((nr50 >> 4) & 7) + 1) : 0;
+  float right = (nr51 & (0x01 << channel)) ? delta * ((nr50 & 7) + 1) : 0;
+  m_output->addDelta(time, left, right);
+}
+
+uint8
+APU::channelOutput(uint8 channel) const
+{
+  const ApuChannel& ch = m_channels[channel];
+  if (!ch.enabled) {
+    return 0;
+  }
+  if (channel == 3) {
+    return (ch.lfsr & 1) ? 0 : ch.volume;
+  }
+  return patternOutput(channel, ch.position);
+}
+
+uint8
+APU::patternOutput(uint8 channel, uint8 position) const
+{
+  switch (channel) {
+    case 0:
+      return DUTY_PATTERNS[nr11 >> 6][position] ? m_channels[0].volume : 0;
+    case 1:
+      return DUTY_PATTERNS[nr21 >> 6][position] ? m_channels[1].volume : 0;
+    default: {
+      uint8 sample = wave_ram[position / 2];
+      sample = (position & 1) ? sample & 0x0F : sample >> 4;
+      return sample >> WAVE_SHIFTS[(nr32 >> 5) & 3];
+    }
+  }
+}
+
+uint32
+APU::channelPeriod(uint8 channel) const
+{
+  switch (channel) {
+    case 0:
+      return (2048 - (nr13 | ((nr14 & 7) << 8))) * 4;
+    case 1:
+      return (2048 - (nr23 | ((nr24 & 7) << 8))) * 4;
+    case 2:
+      return (2048 - (nr33 | ((nr34 & 7) << 8))) * 2;
+    default: {
+      uint8 shift = nr43 >> 4;
+      if (shift >= 14) {
+        return 0;
+      }
+      uint8 divisor = nr43 & 7;
+      return (divisor ? divisor * 16 : 8) << shift;
+    }
+  }
+}
+
+bool
+APU::isDacEnabled(uint8 channel) const
+{
+  if (channel == 2) {
+    return nr30 & 0x80;
+  }
+  return envelopeRegister(channel) & 0xF8;
+}
+
+uint8
+APU::envelopeRegister(uint8 channel) const
+{
+  switch (channel) {
+    case 0:
+      return nr12;
+    case 1:
+      return nr22;
+    case 3:
+      return nr42;
+    default:
+      return 0;
+  }
+}
+
+uint8
+APU::controlRegister(uint8 channel) const
+{
+  switch (channel) {
+    case 0:
+      return nr14;
+    case 1:
+      return nr24;
+    case 2:
+      return nr34;
+    default:
+      return nr44;
+  }
+}
+
+void
+APU::disableChannel(uint8 channel)
+{
+  m_channels[channel].enabled = false;
+  setChannelOutput(channel, m_time, 0);
+}
+
+void
+APU::trigger(uint8 channel)
+{
+  ApuChannel& ch = m_channels[channel];
+  if (ch.length == 0) {
+    ch.length = channel == 2 ? 256 : 64;
+  }
+  ch.enabled = isDacEnabled(channel);
+  ch.next_event = m_time + channelPeriod(channel);
+  if (channel == 2) {
+    ch.position = 0;
+  } else {
+    ch.volume = envelopeRegister(channel) >> 4;
+    ch.envelope_timer = envelopeRegister(channel) & 7;
+  }
+  if (channel == 3) {
+    ch.lfsr = 0x7FFF;
+  }
+  if (channel == 0) {
+    m_shadow_frequency = nr13 | ((nr14 & 7) << 8);
+    uint8 period = (nr10 >> 4) & 7;
+    m_sweep_timer = period ? period : 8;
+    m_sweep_enabled = period || (nr10 & 7);
+    if (nr10 & 7) {
+      calculateSweep();
+    }
+  }
+  setChannelOutput(channel, m_time, channelOutput(channel));
+}
+
+void
+APU::clockLength()
+{
+  for (uint8 channel = 0; channel < 4; channel++) {
+    ApuChannel& ch = m_channels[channel];
+    if ((controlRegister(channel) & 0x40) && ch.length > 0) {
+      if (--ch.length == 0) {
+        disableChannel(channel);
+      }
+    }
+  }
+}
+
+void
+APU::clockEnvelope()
+{
+  for (uint8 channel : { 0, 1, 3 }) {
+    ApuChannel& ch = m_channels[channel];
+    uint8 envelope = envelopeRegister(channel);
+    uint8 period = envelope & 7;
+    if (!ch.enabled || period == 0) {
+      continue;
+    }
+    if (ch.envelope_timer > 1) {
+      ch.envelope_timer--;
+      continue;
+    }
+    ch.envelope_timer = period;
+    if ((envelope & 0x08) && ch.volume < 15) {
+      ch.volume++;
+    } else if (!(envelope & 0x08) && ch.volume > 0) {
+      ch.volume--;
+    }
+    setChannelOutput(channel, m_time, channelOutput(channel));
+  }
+}
+
+void
+APU::clockSweep()
+{
+  if (--m_sweep_timer > 0) {
+    return;
+  }
+  uint8 period = (nr10 >> 4) & 7;
+  m_sweep_timer = period ? period : 8;
+  if (!m_sweep_enabled || period == 0 || !m_channels[0].enabled) {
+    return;
+  }
+  uint16 frequency = calculateSweep();
+  if (frequency <= 2047 && (nr10 & 7)) {
+    m_shadow_frequency = frequency;
+    nr13 = frequency & 0xFF;
+    nr14 = (nr14 & ~7) | (frequency >> 8);
+    calculateSweep();
+  }
+}
+
+uint16
+APU::calculateSweep()
+{
+  uint16 delta = m_shadow_frequency >> (nr10 & 7);
+  uint16 frequency =
+    (nr10 & 0x08) ? m_shadow_frequency - delta : m_shadow_frequency + delta;
+  if (frequency > 2047) {
+    disableChannel(0);
+  }
+  return frequency;
+}
+
+void
+APU::mix(float& left, float& right) const
+{
+  left = right = 0;
+  for (uint8 channel = 0; channel < 4; channel++) {
+    float output = m_channels[channel].output * VOLUME_SCALE;
+    if (nr51 & (0x10 << channel)) {
+      left += output * (((nr50 >> 4) & 7) + 1);
+    }
+    if (nr51 & (0x01 << channel)) {
+      right += output * ((nr50 & 7) + 1);
+    }
+  }
 }
 
 uint8
 APU::read(uint16 addr)
 {
+  catchUp();
   switch (addr) {
     case 0xFF10:
       return readNR10();
@@ -107,6 +491,26 @@ APU::read(uint16 addr)
 void
 APU::write(uint16 addr, uint8 val)
 {
+  // while powered off only NR52, wave ram and the length counters can be
+  // written, the rest of the NRx1 registers stays cleared
+  if (!(nr52 & 0x80) && addr != 0xFF26 && addr < 0xFF30) {
+    switch (addr) {
+      case 0xFF11:
+        writeLength(0, val);
+        break;
+      case 0xFF16:
+        writeLength(1, val);
+        break;
+      case 0xFF1B:
+        writeLength(2, val);
+        break;
+      case 0xFF20:
+        writeLength(3, val);
+        break;
+    }
+    return;
+  }
+  catchUp();
   switch (addr) {
     case 0xFF10:
       writeNR10(val);
@@ -310,7 +714,11 @@ APU::readNR51()
 uint8
 APU::readNR52()
 {
-  return nr52 | 0x70;
+  uint8 status = 0;
+  for (uint8 channel = 0; channel < 4; channel++) {
+    status |= m_channels[channel].enabled << channel;
+  }
+  return (nr52 & 0x80) | 0x70 | status;
 }
 
 uint8
@@ -326,16 +734,30 @@ APU::writeNR10(uint8 val)
   nr10 = val | 0x80;
 }
 
+void
+APU::writeLength(uint8 channel, uint8 val)
+{
+  if (channel == 2) {
+    m_channels[2].length = 256 - val;
+  } else {
+    m_channels[channel].length = 64 - (val & 0x3F);
+  }
+}
+
 void
 APU::writeNR11(uint8 val)
 {
   nr11 = val;
+  writeLength(0, val);
 }
 
 void
 APU::writeNR12(uint8 val)
 {
   nr12 = val;
+  if (!isDacEnabled(0)) {
+    disableChannel(0);
+  }
 }
 
 void
@@ -348,18 +770,25 @@ void
 APU::writeNR14(uint8 val)
 {
   nr14 = val | 0x38;
+  if (val & 0x80) {
+    trigger(0);
+  }
 }
 
 void
 APU::writeNR21(uint8 val)
 {
   nr21 = val;
+  writeLength(1, val);
 }
 
 void
 APU::writeNR22(uint8 val)
 {
   nr22 = val;
+  if (!isDacEnabled(1)) {
+    disableChannel(1);
+  }
 }
 
 void
@@ -372,24 +801,32 @@ void
 APU::writeNR24(uint8 val)
 {
   nr24 = val | 0x38;
+  if (val & 0x80) {
+    trigger(1);
+  }
 }
 
 void
 APU::writeNR30(uint8 val)
 {
   nr30 = val | 0x7F;
+  if (!isDacEnabled(2)) {
+    disableChannel(2);
+  }
 }
 
 void
 APU::writeNR31(uint8 val)
 {
   nr31 = val;
+  writeLength(2, val);
 }
 
 void
 APU::writeNR32(uint8 val)
 {
   nr32 = val | 0x9F;
+  setChannelOutput(2, m_time, channelOutput(2));
 }
 
 void
@@ -402,18 +839,25 @@ void
 APU::writeNR34(uint8 val)
 {
   nr34 = val | 0x38;
+  if (val & 0x80) {
+    trigger(2);
+  }
 }
 
 void
 APU::writeNR41(uint8 val)
 {
   nr41 = val | 0xC0;
+  writeLength(3, val);
 }
 
 void
 APU::writeNR42(uint8 val)
 {
   nr42 = val;
+  if (!isDacEnabled(3)) {
+    disableChannel(3);
+  }
 }
 
 void
@@ -426,24 +870,66 @@ void
 APU::writeNR44(uint8 val)
 {
   nr44 = val | 0x3F;
+  if (val & 0x80) {
+    trigger(3);
+  }
 }
 
 void
 APU::writeNR50(uint8 val)
 {
+  float old_left, old_right, left, right;
+  mix(old_left, old_right);
   nr50 = val;
+  mix(left, right);
+  if (m_output) {
+    m_output->addDelta(m_time, left - old_left, right - old_right);
+  }
 }
 
 void
 APU::writeNR51(uint8 val)
 {
+  float old_left, old_right, left, right;
+  mix(old_left, old_right);
   nr51 = val;
+  mix(left, right);
+  if (m_output) {
+    m_output->addDelta(m_time, left - old_left, right - old_right);
+  }
 }
 
 void
 APU::writeNR52(uint8 val)
 {
-  nr52 = (nr52 & 0x0F) | (val & 0x80) | 0x70;
+  bool was_on = nr52 & 0x80;
+  if (was_on && !(val & 0x80)) {
+    // powering off clears every register, the length counters survive on
+    // the DMG so NRx1 is cleared without going through the length
+    writeNR10(0);
+    nr11 = 0;
+    writeNR12(0);
+    writeNR13(0);
+    writeNR14(0);
+    nr21 = 0;
+    writeNR22(0);
+    writeNR23(0);
+    writeNR24(0);
+    writeNR30(0);
+    nr31 = 0;
+    writeNR32(0);
+    writeNR33(0);
+    writeNR34(0);
+    nr41 = 0xC0;
+    writeNR42(0);
+    writeNR43(0);
+    writeNR44(0);
+    writeNR50(0);
+    writeNR51(0);
+  } else if (!was_on && (val & 0x80)) {
+    m_frame_sequencer = 0;
+  }
+  nr52 = (val & 0x80) | 0x70;
 }
 
 void
@@ -0,0 +1,284 @@
+#include "audio.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Windowed sinc sampled at every sub sample phase, normalized so each
+// phase adds exactly the delta that was requested
+struct BlipKernel
+{
+  float taps[BlipBuffer::Phases][BlipBuffer::Taps];
+
+  BlipKernel()
+  {
+    const double pi = 3.14159265358979323846;
+    // a bit under nyquist to keep the aliasing out of the audible range
+    const double cutoff = 0.9;
+    const int half = BlipBuffer::Taps / 2;
+    for (int phase = 0; phase < BlipBuffer::Phases; phase++) {
+      double sum = 0;
+      for (int i = 0; i < BlipBuffer::Taps; i++) {
+        double x =
+          i - half + 1 - static_cast<double>(phase) / BlipBuffer::Phases;
+        double sinc = x == 0 ? cutoff : std::sin(pi * cutoff * x) / (pi * x);
+        // blackman window over the whole kernel
+        double w = (x + half) / BlipBuffer::Taps;
+        double window =
+          0.42 - 0.5 * std::cos(2 * pi * w) + 0.08 * std::cos(4 * pi * w);
+        taps[phase][i] = sinc * window;
+        sum += taps[phase][i];
+      }
+      for (int i = 0; i < BlipBuffer::Taps; i++) {
+        taps[phase][i] /= sum;
+      }
+    }
+  }
+};
+
+const BlipKernel&
+getKernel()
+{
+  static const BlipKernel kernel;
+  return kernel;
+}
+
+void
+writeLittleEndian(std::ofstream& file, uint32 value, int bytes)
+{
+  for (int i = 0; i < bytes; i++) {
+    file.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+  }
+}
+
+}
+
+AudioRing::AudioRing(uint32 capacity_frames)
+{
+  uint32 capacity = roundUpPowerOfTwo(capacity_frames);
+  m_buffer.resize(capacity * 2);
+  m_mask = capacity - 1;
+}
+
+uint32
+AudioRing::push(const int16* frames, uint32 count)
+{
+  uint32 write = m_write.load(std::memory_order_relaxed);
+  uint32 read = m_read.load(std::memory_order_acquire);
+  count = std::min(count, capacity() - (write - read));
+  for (uint32 i = 0; i < count; i++) {
+    uint32 index = ((write + i) & m_mask) * 2;
+    m_buffer[index] = frames[i * 2];
+    m_buffer[index + 1] = frames[i * 2 + 1];
+  }
+  m_write.store(write + count, std::memory_order_release);
+  return count;
+}
+
+uint32
+AudioRing::pop(int16* frames, uint32 count)
+{
+  uint32 read = m_read.load(std::memory_order_relaxed);
+  uint32 write = m_write.load(std::memory_order_acquire);
+  count = std::min(count, write - read);
+  for (uint32 i = 0; i < count; i++) {
+    uint32 index = ((read + i) & m_mask) * 2;
+    frames[i * 2] = m_buffer[index];
+    frames[i * 2 + 1] = m_buffer[index + 1];
+  }
+  m_read.store(read + count, std::memory_order_release);
+  return count;
+}
+
+uint32
+AudioRing::size() const
+{
+  return m_write.load(std::memory_order_acquire) -
+         m_read.load(std::memory_order_acquire);
+}
+
+BlipBuffer::BlipBuffer(uint32 clock_rate,
+                       uint32 sample_rate,
+                       uint32 max_samples)
+  : m_factor(static_cast<double>(sample_rate) / clock_rate)
+  , m_deltas(max_samples + Taps, 0)
+{
+  getKernel();
+}
+
+void
+BlipBuffer::clear(uint64 clock)
+{
+  m_start_clock = clock;
+  m_integrator = 0;
+  std::fill(m_deltas.begin(), m_deltas.end(), 0);
+}
+
+void
+BlipBuffer::setRates(uint32 clock_rate, double sample_rate)
+{
+  m_factor = sample_rate / clock_rate;
+}
+
+void
+BlipBuffer::addDelta(uint64 clock, float delta)
+{
+  double position = std::max(0.0, (clock - m_start_clock) * m_factor);
+  uint32 index = static_cast<uint32>(position);
+  if (index + Taps > m_deltas.size()) {
+    // nobody read the samples in time, nothing sensible to do with it
+    return;
+  }
+  uint32 phase = static_cast<uint32>((position - index) * Phases);
+  const float* taps = getKernel().taps[phase];
+  // scaling into a local first tells the compiler the two arrays can't
+  // overlap, which lets both loops vectorize
+  float scaled[Taps];
+  for (int i = 0; i < Taps; i++) {
+    scaled[i] = delta * taps[i];
+  }
+  float* deltas = &m_deltas[index];
+  for (int i = 0; i < Taps; i++) {
+    deltas[i] += scaled[i];
+  }
+}
+
+uint32
+BlipBuffer::samplesAvailable(uint64 clock) const
+{
+  double available = (clock - m_start_clock) * m_factor;
+  if (available <= 0) {
+    return 0;
+  }
+  return std::min(static_cast<uint32>(available),
+                  static_cast<uint32>(m_deltas.size() - Taps));
+}
+
+void
+BlipBuffer::readSamples(float* out, uint32 count)
+{
+  for (uint32 i = 0; i < count; i++) {
+    m_integrator += m_deltas[i];
+    out[i] = m_integrator;
+  }
+  // the tails of the last deltas still belong to future samples
+  std::copy(m_deltas.begin() + count, m_deltas.end(), m_deltas.begin());
+  std::fill(m_deltas.end() - count, m_deltas.end(), 0);
+  m_start_clock += count / m_factor;
+}
+
+AudioOutput::AudioOutput(uint32 sample_rate)
+  : m_sample_rate(sample_rate)
+  , m_left(GB_CLOCK_RATE, sample_rate, sample_rate / 10)
+  , m_right(GB_CLOCK_RATE, sample_rate, sample_rate / 10)
+  // roughly the 20Hz high pass of the real hardware
+  , m_charge_factor(
+      std::pow(0.999958f, static_cast<float>(GB_CLOCK_RATE) / sample_rate))
+  , m_left_samples(sample_rate / 10)
+  , m_right_samples(sample_rate / 10)
+  , m_frames(sample_rate / 10 * 2)
+  , m_ring(sample_rate / 4)
+{
+}
+
+void
+AudioOutput::clear(uint64 clock)
+{
+  m_left.clear(clock);
+  m_right.clear(clock);
+  m_capacitor[0] = m_capacitor[1] = 0;
+}
+
+void
+AudioOutput::setRateAdjust(double ratio)
+{
+  m_left.setRates(GB_CLOCK_RATE, m_sample_rate * ratio);
+  m_right.setRates(GB_CLOCK_RATE, m_sample_rate * ratio);
+}
+
+void
+AudioOutput::addDelta(uint64 clock, float left, float right)
+{
+  if (left != 0) {
+    m_left.addDelta(clock, left);
+  }
+  if (right != 0) {
+    m_right.addDelta(clock, right);
+  }
+}
+
+void
+AudioOutput::endFrame(uint64 clock)
+{
+  uint32 count = m_left.samplesAvailable(clock);
+  m_left.readSamples(m_left_samples.data(), count);
+  m_right.readSamples(m_right_samples.data(), count);
+  const float* sides[2] = { m_left_samples.data(), m_right_samples.data() };
+  for (uint32 i = 0; i < count; i++) {
+    for (int side = 0; side < 2; side++) {
+      float in = sides[side][i];
+      float out = in - m_capacitor[side];
+      m_capacitor[side] = in - out * m_charge_factor;
+      m_frames[i * 2 + side] =
+        static_cast<int16>(std::clamp(out, -32768.0f, 32767.0f));
+    }
+  }
+  m_ring.push(m_frames.data(), count);
+}
+
+AudioFileWriter::AudioFileWriter(const std::string& path, uint32 sample_rate)
+  : m_file(path, std::ios::binary | std::ios::trunc)
+  , m_sample_rate(sample_rate)
+{
+  if (!m_file.is_open()) {
+    log_error("Failed to open %s for writing audio", path.c_str());
+    return;
+  }
+  m_wav = path.size() >= 4 && path.compare(path.size() - 4, 4, ".wav") == 0;
+  if (m_wav) {
+    writeHeader();
+  }
+}
+
+AudioFileWriter::~AudioFileWriter()
+{
+  if (m_file.is_open() && m_wav) {
+    m_file.seekp(0);
+    writeHeader();
+  }
+}
+
+void
+AudioFileWriter::writeHeader()
+{
+  constexpr uint32 BytesPerFrame = 2 * sizeof(int16);
+  uint32 data_size = m_frames_written * BytesPerFrame;
+  m_file.write("RIFF", 4);
+  writeLittleEndian(m_file, 36 + data_size, 4);
+  m_file.write("WAVEfmt ", 8);
+  writeLittleEndian(m_file, 16, 4);
+  // pcm, two channels
+  writeLittleEndian(m_file, 1, 2);
+  writeLittleEndian(m_file, 2, 2);
+  writeLittleEndian(m_file, m_sample_rate, 4);
+  writeLittleEndian(m_file, m_sample_rate * BytesPerFrame, 4);
+  writeLittleEndian(m_file, BytesPerFrame, 2);
+  writeLittleEndian(m_file, 16, 2);
+  m_file.write("data", 4);
+  writeLittleEndian(m_file, data_size, 4);
+}
+
+void
+AudioFileWriter::write(const int16* frames, uint32 count)
+{
+  if (HostLittleEndian) {
+    m_file.write(reinterpret_cast<const char*>(frames),
+                 count * 2 * sizeof(int16));
+  } else {
+    for (uint32 i = 0; i < count * 2; i++) {
+      writeLittleEndian(m_file, static_cast<uint16>(frames[i]), 2);
+    }
+  }
+  m_frames_written += count;
+}
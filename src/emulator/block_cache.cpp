@@ -0,0 +1,128 @@
+#include "block_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// bytes taken by every opcode, a cb prefix counts with its second byte
+constexpr uint8 InstructionLengths[256] = {
+  1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, // 0x00
+  1, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x10
+  2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x20
+  2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x30
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x50
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x70
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x80
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x90
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xA0
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xB0
+  1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, // 0xC0
+  1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1, // 0xD0
+  2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // 0xE0
+  2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // 0xF0
+};
+
+}
+
+uint8
+BlockCache::instructionLength(uint8 opcode)
+{
+  return InstructionLengths[opcode];
+}
+
+bool
+BlockCache::endsBlock(uint8 opcode)
+{
+  if ((opcode & 0xC7) == 0xC7) {
+    // rst
+    return true;
+  }
+  switch (opcode) {
+    case 0x10: // stop
+    case 0x18: // jr
+    case 0x20:
+    case 0x28:
+    case 0x30:
+    case 0x38:
+    case 0x76: // halt
+    case 0xC0: // ret
+    case 0xC8:
+    case 0xC9:
+    case 0xD0:
+    case 0xD8:
+    case 0xD9:
+    case 0xC2: // jp
+    case 0xC3:
+    case 0xCA:
+    case 0xD2:
+    case 0xDA:
+    case 0xE9:
+    case 0xC4: // call
+    case 0xCC:
+    case 0xCD:
+    case 0xD4:
+    case 0xDC:
+      return true;
+  }
+  return false;
+}
+
+CodeBlock*
+BlockCache::find(uint32 key)
+{
+  auto it = m_blocks.find(key);
+  return it != m_blocks.end() ? &it->second : nullptr;
+}
+
+CodeBlock*
+BlockCache::insert(uint32 key, CodeBlock&& block)
+{
+  if ((key >> 16) == RamBank) {
+    markPages(block);
+    m_ram_blocks.push_back(key);
+  }
+  // references to the other blocks stay valid
+  return &(m_blocks[key] = std::move(block));
+}
+
+void
+BlockCache::markPages(const CodeBlock& block)
+{
+  for (uint32 page = block.start >> 8; page <= (block.end - 1) >> 8; page++) {
+    m_code_pages[page] = 1;
+  }
+}
+
+void
+BlockCache::invalidate(uint16 addr)
+{
+  uint32 page = addr >> 8;
+  auto covers_page = [this, page](uint32 key) {
+    const CodeBlock& block = m_blocks.at(key);
+    return (block.start >> 8) <= page && ((block.end - 1) >> 8) >= page;
+  };
+  auto removed =
+    std::partition(m_ram_blocks.begin(), m_ram_blocks.end(), [&](uint32 key) {
+      return !covers_page(key);
+    });
+  for (auto it = removed; it != m_ram_blocks.end(); it++) {
+    m_blocks.erase(*it);
+  }
+  m_ram_blocks.erase(removed, m_ram_blocks.end());
+  // pages can be shared with blocks that are still valid
+  std::memset(m_code_pages, 0, sizeof(m_code_pages));
+  for (uint32 key : m_ram_blocks) {
+    markPages(m_blocks.at(key));
+  }
+}
+
+void
+BlockCache::clear()
+{
+  m_blocks.clear();
+  m_ram_blocks.clear();
+  std::memset(m_code_pages, 0, sizeof(m_code_pages));
+}
@@ -1,31 +1,18 @@
 #include "cartridge.h"
 
-#include <cstring>
-#include <fstream>
-
 #include "mbc_controller.h"
 
 Cartridge::Cartridge(std::string location)
   : m_cartridge_location(location)
 {
   log_info("Loading %s cartridge", m_cartridge_location.c_str());
-  // Open cartridge
-  std::ifstream ifs(m_cartridge_location, std::ifstream::binary);
-  std::filebuf* pbuf = ifs.rdbuf();
-  // get cartridge size
-  std::size_t size = pbuf->pubseekoff(0, ifs.end, ifs.in);
-  pbuf->pubseekpos(0, ifs.in);
-  m_data = std::make_unique<uint8[]>(size);
-  // read data
-  pbuf->sgetn(reinterpret_cast<char*>(m_data.get()), size);
-  ifs.close();
-  // set values
-  m_cartridge_header = reinterpret_cast<header*>(m_data.get() + 0x100);
-  // last byte also used to indicate if it supports gmb colour
-  m_cartridge_header->title[15] = 0;
-  m_cartridge_size = size;
-
-  m_valid = checkData();
+  m_rom = RomImage::load(m_cartridge_location);
+  if (!m_rom) {
+    return;
+  }
+  m_cartridge_header = m_rom->getHeader();
+
+  m_valid = m_rom->hasValidHeader();
   if (!m_valid) {
     log_error("Loaded cartridge isn't valid");
     // Some test roms don't have valid headers so we won't fail here
@@ -44,8 +31,11 @@ Cartridge::Cartridge(std::string location)
   log_info("%s", str.c_str());
 }
 
-// needed because of fwd declaration of MBC_Handler
-Cartridge::~Cartridge() = default;
+Cartridge::~Cartridge()
+{
+  // the handler points into the rom image so it has to go first
+  m_mbc_handler.reset();
+}
 
 std::string
 Cartridge::getTitle()
@@ -92,6 +82,42 @@ Cartridge::read(uint16 address)
   return m_mbc_handler->read(address);
 }
 
+uint16
+Cartridge::romBank(uint16 address) const
+{
+  return m_mbc_handler->romBank(address);
+}
+
+void
+Cartridge::setSavesEnabled(bool enabled)
+{
+  m_mbc_handler->setSavesEnabled(enabled);
+}
+
+void
+Cartridge::saveState(MBC_State& state) const
+{
+  m_mbc_handler->saveState(state);
+}
+
+void
+Cartridge::loadState(const MBC_State& state)
+{
+  m_mbc_handler->loadState(state);
+}
+
+void
+Cartridge::flushSave()
+{
+  m_mbc_handler->flush();
+}
+
+void
+Cartridge::setSaveDirectory(const std::string& directory)
+{
+  MBC_Handler::setSaveDirectory(directory);
+}
+
 bool
 Cartridge::isValidCartridge()
 {
@@ -110,35 +136,3 @@ Cartridge::getDebugMsg()
   str += "  ROM Version: " + std::to_string(m_cartridge_header->version);
   return str;
 }
-
-bool
-Cartridge::checkData()
-{
-  bool flag = true;
-  uint8_t checksum = 0;
-
-  if (m_cartridge_header->ram_size != 0 &&
-      RAM_SIZES.find(m_cartridge_header->ram_size) == RAM_SIZES.cend()) {
-    log_error("Unknown ram size 0x%X", m_cartridge_header->ram_size);
-    flag = false;
-  }
-
-  for (uint16_t address = 0x0134; address <= 0x014C; address++) {
-    checksum = checksum - m_data[address] - 1;
-  }
-
-  if (m_cartridge_header->checksum != checksum) {
-    log_error(
-      "Checksums do not match %d is in the header and %d was calculated",
-      m_cartridge_header->checksum,
-      checksum);
-    flag = false;
-  }
-
-  if (std::memcmp(
-        NINTENDO_LOGO, m_cartridge_header->logo, sizeof(NINTENDO_LOGO)) != 0) {
-    log_error("Nintendo logos do not match");
-    flag = false;
-  }
-  return flag;
-}
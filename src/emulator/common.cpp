@@ -1,5 +1,7 @@
 #include "common.h"
 
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <fstream>
@@ -8,23 +10,167 @@
 char*
 getTimeString()
 {
+  // ctime uses a shared static buffer, multiple emulators can log in parallel
+  thread_local char t[32];
   std::time_t result = std::time(nullptr);
-  char* t = std::ctime(&result);
-  if (t[std::strlen(t) - 1] == '\n')
-    t[std::strlen(t) - 1] = '\0';
+  std::tm tm_result;
+  localtime_r(&result, &tm_result);
+  std::strftime(t, sizeof(t), "%a %b %e %H:%M:%S %Y", &tm_result);
   return t;
 }
 
+namespace {
+
+constexpr uint64 Prime1 = 0x9E3779B185EBCA87;
+constexpr uint64 Prime2 = 0xC2B2AE3D27D4EB4F;
+constexpr uint64 Prime3 = 0x165667B19E3779F9;
+constexpr uint64 Prime4 = 0x85EBCA77C2B2AE63;
+constexpr uint64 Prime5 = 0x27D4EB2F165667C5;
+
+inline uint64
+rotl(uint64 value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+template<typename T>
+inline T
+readLE(const uint8* data)
+{
+  // the hosts we build for are little endian
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+inline uint64
+round(uint64 acc, uint64 lane)
+{
+  return rotl(acc + lane * Prime2, 31) * Prime1;
+}
+
+inline uint64
+mergeRound(uint64 hash, uint64 acc)
+{
+  return (hash ^ round(0, acc)) * Prime1 + Prime4;
+}
+
+}
+
+uint64
+hash64(const void* data, uint64 size, uint64 seed)
+{
+  const uint8* p = static_cast<const uint8*>(data);
+  const uint8* end = p + size;
+  uint64 hash;
+  if (size >= 32) {
+    // four independent lanes the compiler can keep in registers
+    uint64 acc[4] = { seed + Prime1 + Prime2, seed + Prime2, seed,
+                      seed - Prime1 };
+    for (; p + 32 <= end; p += 32) {
+      for (int lane = 0; lane < 4; lane++) {
+        acc[lane] = round(acc[lane], readLE<uint64>(p + lane * 8));
+      }
+    }
+    hash = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) +
+           rotl(acc[3], 18);
+    for (uint64 lane : acc) {
+      hash = mergeRound(hash, lane);
+    }
+  } else {
+    hash = seed + Prime5;
+  }
+  hash += size;
+  for (; p + 8 <= end; p += 8) {
+    hash = rotl(hash ^ round(0, readLE<uint64>(p)), 27) * Prime1 + Prime4;
+  }
+  if (p + 4 <= end) {
+    hash = rotl(hash ^ (readLE<uint32>(p) * Prime1), 23) * Prime2 + Prime3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    hash = rotl(hash ^ (*p * Prime5), 11) * Prime1;
+  }
+  hash ^= hash >> 33;
+  hash *= Prime2;
+  hash ^= hash >> 29;
+  hash *= Prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
 void
 Logger::log(std::string msg)
 {
   std::lock_guard<std::mutex> guard(logger_lock);
-  if (DEBUG_ENABLED) {
-    if (myfile.is_open()) {
-      myfile << msg << std::endl;
-      myfile.flush();
-      return;
-    }
+  if (myfile.is_open()) {
+    myfile << msg << std::endl;
+    return;
   }
   std::cout << msg << std::endl;
 }
+
+void
+Logger::setFile(const std::string& path)
+{
+  std::lock_guard<std::mutex> guard(logger_lock);
+  if (myfile.is_open()) {
+    myfile.close();
+  }
+  if (!path.empty()) {
+    myfile.open(path, std::ios_base::app);
+  }
+}
+
+uint32
+roundUpPowerOfTwo(uint32 value)
+{
+  uint32 result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+bool
+parseNumber(const char* text, int base, uint64& value)
+{
+  if (*text == '\0' || *text == '-' || *text == '+') {
+    return false;
+  }
+  char* end = nullptr;
+  errno = 0;
+  unsigned long long result = std::strtoull(text, &end, base);
+  if (*end != '\0' || errno == ERANGE) {
+    return false;
+  }
+  value = result;
+  return true;
+}
+
+const Palette*
+findPalette(const std::string& name)
+{
+  static const std::pair<const char*, Palette> Palettes[] = {
+    { "green", { GB_COLORS[0], GB_COLORS[1], GB_COLORS[2], GB_COLORS[3] } },
+    { "gray", { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 } },
+    { "pocket", { 0xFFC4CFA1, 0xFF8B956D, 0xFF4D533C, 0xFF1F1F1F } },
+  };
+  for (const auto& palette : Palettes) {
+    if (name == palette.first) {
+      return &palette.second;
+    }
+  }
+  return nullptr;
+}
+
+void
+shadesToArgb(const uint8* shades,
+             uint32* argb,
+             uint32 count,
+             const Palette& palette)
+{
+  for (uint32 i = 0; i < count; i++) {
+    argb[i] = palette[shades[i] & 0x03];
+  }
+}
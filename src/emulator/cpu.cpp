@@ -1,10 +1,70 @@
 #include "cpu.h"
 #include "common.h"
+#include "debugger.h"
 #include "mmu.h"
+#include "trace.h"
+
+#include <algorithm>
 
 CPU::CPU()
 {
   initialize();
+  interrupt_instruction = std::bind(&CPU::serviceInterrupt, this);
+  // bound once instead of on every prefixed instruction
+  for (uint16 opcode = 0; opcode < 256; opcode++) {
+    prefix_instructions[opcode] = fetchPrefixInstruction(opcode);
+  }
+}
+
+CPU&
+CPU::operator=(const CPU& other)
+{
+  AF = other.AF;
+  BC = other.BC;
+  DE = other.DE;
+  HL = other.HL;
+  SP = other.SP;
+  PC = other.PC;
+
+  ime = other.ime;
+  IER = other.IER;
+  IFR = other.IFR;
+
+  flag_op = other.flag_op;
+  flag_lhs = other.flag_lhs;
+  flag_rhs = other.flag_rhs;
+  flag_carry = other.flag_carry;
+  flag_result = other.flag_result;
+  verify_f = other.verify_f;
+
+  ioData = other.ioData;
+  highByte = other.highByte;
+  lowByte = other.lowByte;
+
+  instruction_cycles = other.instruction_cycles;
+  halted = other.halted;
+  use_prefix_instruction = other.use_prefix_instruction;
+  curr_opcode = other.curr_opcode;
+  curr_kind = other.curr_kind;
+  idle_clean = false;
+  idle_found = false;
+
+  // bound instructions reference the registers of the other cpu
+  switch (curr_kind) {
+    case InstructionKind::Opcode:
+      current_instruction = &opcode_map.at(curr_opcode);
+      break;
+    case InstructionKind::Prefix:
+      current_instruction = &prefix_instructions[curr_opcode];
+      break;
+    case InstructionKind::Interrupt:
+      current_instruction = &interrupt_instruction;
+      break;
+  }
+  // the memory the blocks were decoded from changed
+  block_cache.clear();
+  curr_block = nullptr;
+  return *this;
 }
 
 void
@@ -33,10 +93,12 @@ CPU::initialize()
   HL = 0x014D;
   SP = 0xFFFE;
   PC = 0x0100;
+  flag_op = FlagOp::None;
 
   instruction_cycles = 0;
   use_prefix_instruction = false;
   curr_opcode = 0;
+  curr_kind = InstructionKind::Opcode;
   halted = false;
 
   ime = Ime::Disable;
@@ -52,64 +114,40 @@ void
 CPU::cycle()
 {
   bool servicingInterrupt = false;
+  idle_found = false;
+  idle_cycles++;
   if (instruction_cycles == 0) {
     uint8 interrupts = getInterrupts();
     if (interrupts != 0 && !use_prefix_instruction) {
       halted = false;
       if (ime == Ime::Enable) {
-        current_instruction = std::bind(&CPU::serviceInterrupt, this);
+        current_instruction = &interrupt_instruction;
+        curr_kind = InstructionKind::Interrupt;
         servicingInterrupt = true;
-        log_debug(
-          "DEBUG_STATE A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X "
-          "L:%02X SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X",
-          readRegister(AF, RegisterBits::High),
-          readRegister(AF, RegisterBits::Low),
-          readRegister(BC, RegisterBits::High),
-          readRegister(BC, RegisterBits::Low),
-          readRegister(DE, RegisterBits::High),
-          readRegister(DE, RegisterBits::Low),
-          readRegister(HL, RegisterBits::High),
-          readRegister(HL, RegisterBits::Low),
-          SP,
-          PC - 1,
-          mmu->read(PC - 1, Component::CPU),
-          mmu->read(PC, Component::CPU),
-          mmu->read(PC + 1, Component::CPU),
-          mmu->read(PC + 2, Component::CPU));
       }
     }
 
     if (!servicingInterrupt) {
       if (use_prefix_instruction) {
-        current_instruction = fetchPrefixInstruction(ioData);
+        current_instruction = &prefix_instructions[ioData];
+        curr_kind = InstructionKind::Prefix;
         use_prefix_instruction = false;
       } else {
-        if (bad_opcodes.find(ioData) != bad_opcodes.end()) {
-          log_error("Bad opcode: 0x%02X", ioData);
-          abort();
-        }
+        uint16 addr = PC - 1;
         if (!halted || servicingInterrupt) {
-          // A:00 F:11 B:22 C:33 D:44 E:55 H:66 L:77 SP:8888 PC:9999
-          // PCMEM:AA,BB,CC,DD
-          log_debug(
-            "DEBUG_STATE A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X "
-            "L:%02X SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X",
-            readRegister(AF, RegisterBits::High),
-            readRegister(AF, RegisterBits::Low),
-            readRegister(BC, RegisterBits::High),
-            readRegister(BC, RegisterBits::Low),
-            readRegister(DE, RegisterBits::High),
-            readRegister(DE, RegisterBits::Low),
-            readRegister(HL, RegisterBits::High),
-            readRegister(HL, RegisterBits::Low),
-            SP,
-            PC - 1,
-            mmu->read(PC - 1, Component::CPU),
-            mmu->read(PC, Component::CPU),
-            mmu->read(PC + 1, Component::CPU),
-            mmu->read(PC + 2, Component::CPU));
+          if (tracer != nullptr) {
+            traceInstruction(addr);
+          }
+          if (pc_breakpoints != nullptr &&
+              ((pc_breakpoints[addr >> 6] >> (addr & 63)) & 1) != 0) {
+            debugger->onInstruction(addr);
+          }
+          if (idle_detection) {
+            trackIdleLoop();
+          }
         }
-        current_instruction = opcode_map.at(ioData);
+        current_instruction = decode(addr);
+        curr_kind = InstructionKind::Opcode;
       }
     }
     // not correct when servicing an interrupt
@@ -117,10 +155,11 @@ CPU::cycle()
   }
 
   if (halted) {
+    idle_clean = false;
     return;
   }
 
-  current_instruction();
+  (*current_instruction)();
 
   if (instruction_cycles == 0 &&
       (ime == Ime::PendingEnable || ime == Ime::RequestEnable)) {
@@ -133,140 +172,99 @@ CPU::cycle()
   }
 }
 
-std::function<void()>
-CPU::fetchPrefixInstruction(uint8 opcode)
+const std::function<void()>*
+CPU::decode(uint16 addr)
 {
-  std::function<void()> instr = nullptr;
-  uint16* reg = nullptr;
-  bool indirect = false;
-  CPU::RegisterBits reg_bits = CPU::RegisterBits::Full;
+  if (block_caching) {
+    const CachedInstruction* cached = findCached(addr);
+    // what was fetched decides, the block can be stale during a DMA
+    if (cached != nullptr && cached->opcode == ioData) {
+      return cached->handler;
+    }
+  }
+  if (bad_opcodes.find(ioData) != bad_opcodes.end()) {
+    log_error("Bad opcode: 0x%02X", ioData);
+    abort();
+  }
+  return &opcode_map.at(ioData);
+}
 
-  uint8 reg_val = opcode & 0x7;
-  uint8 index_val = (opcode >> 3) & 0x7;
+const CachedInstruction*
+CPU::findCached(uint16 addr)
+{
+  if (curr_block != nullptr) {
+    std::vector<CachedInstruction>& instructions = curr_block->instructions;
+    if (curr_index + 1 < instructions.size() &&
+        instructions[curr_index + 1].addr == addr) {
+      return &instructions[++curr_index];
+    }
+    if (instructions[curr_index].addr == addr) {
+      // halted or jumped to itself
+      return &instructions[curr_index];
+    }
+  }
+  curr_block = getBlock(addr);
+  curr_index = 0;
+  return curr_block != nullptr ? &curr_block->instructions[0] : nullptr;
+}
 
-  switch (reg_val) {
-    case 0:
-      reg = &BC;
-      reg_bits = CPU::RegisterBits::High;
-      break;
-    case 1:
-      reg = &BC;
-      reg_bits = CPU::RegisterBits::Low;
-      break;
-    case 2:
-      reg = &DE;
-      reg_bits = CPU::RegisterBits::High;
-      break;
-    case 3:
-      reg = &DE;
-      reg_bits = CPU::RegisterBits::Low;
-      break;
-    case 4:
-      reg = &HL;
-      reg_bits = CPU::RegisterBits::High;
-      break;
-    case 5:
-      reg = &HL;
-      reg_bits = CPU::RegisterBits::Low;
-      break;
-    case 6:
-      reg = &HL;
-      indirect = true;
-      break;
-    case 7:
-      reg = &AF;
-      reg_bits = CPU::RegisterBits::High;
-      break;
+CodeBlock*
+CPU::getBlock(uint16 addr)
+{
+  uint16 bank = BlockCache::RamBank;
+  uint32 region_end = 0;
+  if (addr <= RomEnd) {
+    bank = mmu->romBank(addr);
+    region_end = (addr & 0xC000) + 0x4000;
+  } else if (addr >= WramStart && addr <= WramEnd) {
+    region_end = WramEnd + 1;
+  } else if (addr >= HramStart && addr <= HramEnd) {
+    region_end = HramEnd + 1;
+  } else {
+    // vram, oam, echo and cartridge ram are left to the interpreter
+    return nullptr;
+  }
+  uint32 key = BlockCache::key(bank, addr);
+  CodeBlock* block = block_cache.find(key);
+  if (block != nullptr) {
+    return block;
   }
 
-  switch (opcode & 0xC0) {
-    case 0x00:
-      switch (index_val) {
-        case 0:
-          if (indirect) {
-            instr = std::bind(&CPU::rlc_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::rlc_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-        case 1:
-          if (indirect) {
-            instr = std::bind(&CPU::rrc_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::rrc_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-        case 2:
-          if (indirect) {
-            instr = std::bind(&CPU::rl_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::rl_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-        case 3:
-          if (indirect) {
-            instr = std::bind(&CPU::rr_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::rr_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-        case 4:
-          if (indirect) {
-            instr = std::bind(&CPU::sla_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::sla_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-        case 5:
-          if (indirect) {
-            instr = std::bind(&CPU::sra_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::sra_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-        case 6:
-          if (indirect) {
-            instr = std::bind(&CPU::swap_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::swap_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-        case 7:
-          if (indirect) {
-            instr = std::bind(&CPU::srl_ar16, this, std::ref(*reg));
-          } else {
-            instr = std::bind(&CPU::srl_r8, this, std::ref(*reg), reg_bits);
-          }
-          break;
-      }
+  CodeBlock decoded;
+  decoded.start = addr;
+  uint32 pc = addr;
+  while (pc < region_end &&
+         decoded.instructions.size() < BlockCache::MaxInstructions) {
+    uint8 opcode = mmu->read(pc, Component::Debug);
+    uint8 length = BlockCache::instructionLength(opcode);
+    if (pc + length > region_end ||
+        bad_opcodes.find(opcode) != bad_opcodes.end()) {
       break;
-    case 0x40:
-      if (indirect) {
-        instr = std::bind(&CPU::bit_ar16, this, std::ref(*reg), index_val);
-      } else {
-        instr =
-          std::bind(&CPU::bit_r8, this, std::ref(*reg), reg_bits, index_val);
-      }
-      break;
-    case 0x80:
-      if (indirect) {
-        instr = std::bind(&CPU::res_ar16, this, std::ref(*reg), index_val);
-      } else {
-        instr =
-          std::bind(&CPU::res_r8, this, std::ref(*reg), reg_bits, index_val);
-      }
-      break;
-    case 0xC0:
-      if (indirect) {
-        instr = std::bind(&CPU::set_ar16, this, std::ref(*reg), index_val);
-      } else {
-        instr =
-          std::bind(&CPU::set_r8, this, std::ref(*reg), reg_bits, index_val);
-      }
+    }
+    decoded.instructions.push_back(
+      { &opcode_map.at(opcode), static_cast<uint16>(pc), opcode });
+    decoded.bytes.push_back(opcode);
+    for (uint8 i = 1; i < length; i++) {
+      decoded.bytes.push_back(mmu->read(pc + i, Component::Debug));
+    }
+    pc += length;
+    if (BlockCache::endsBlock(opcode)) {
       break;
+    }
+  }
+  if (decoded.instructions.empty()) {
+    return nullptr;
   }
+  decoded.end = pc;
+  return block_cache.insert(key, std::move(decoded));
+}
 
-  return instr;
+void
+CPU::setBlockCaching(bool enabled)
+{
+  block_caching = enabled;
+  block_cache.clear();
+  curr_block = nullptr;
 }
 
 void
@@ -287,60 +285,122 @@ void
 CPU::read(uint16 addr)
 {
   ioData = mmu->read(addr, Component::CPU);
+  if (idle_clean) {
+    trackIdleRead(addr);
+  }
 }
 
 void
 CPU::write(uint16 addr, uint8 val)
 {
+  idle_clean = false;
+  if (addr <= RomEnd) {
+    // the write can switch the bank the current block is in
+    curr_block = nullptr;
+  } else {
+    uint16 target = addr;
+    if (addr >= EchoRamStart && addr <= EchoRamEnd) {
+      target = addr - (EchoRamStart - WramStart);
+    }
+    if (block_cache.hasCode(target)) {
+      block_cache.invalidate(target);
+      curr_block = nullptr;
+    }
+  }
   mmu->write(addr, val, Component::CPU);
 }
 
 void
-CPU::setRegister(uint16& reg, uint16 val, RegisterBits register_bits)
+CPU::traceInstruction(uint16 addr)
 {
-  switch (register_bits) {
-    case RegisterBits::High:
-      reg = (reg & 0x00FF) | (val << 8);
-      break;
-    case RegisterBits::Low:
-      if (&reg == &AF) {
-        // special handling of F register
-        // lowest 4 bits don't exist
-        reg = (reg & 0xFF00) | (val & 0x00F0);
-      } else {
-        reg = (reg & 0xFF00) | (val & 0x00FF);
-      }
-      break;
-    case RegisterBits::Full:
-      if (&reg == &AF) {
-        // special handling of F register
-        // lowest 4 bits don't exist
-        reg = val & 0xFFF0;
-      } else {
-        reg = val;
-      }
-      break;
+  TraceRecord& record = tracer->next();
+  record.cycle = tracer->now();
+  record.pc = addr;
+  record.sp = SP;
+  uint16 af = currentAF();
+  record.a = af >> 8;
+  record.f = af & 0xFF;
+  record.b = BC >> 8;
+  record.c = BC & 0xFF;
+  record.d = DE >> 8;
+  record.e = DE & 0xFF;
+  record.h = HL >> 8;
+  record.l = HL & 0xFF;
+  // the opcode was already fetched, the rest is read without side effects
+  record.mem[0] = ioData;
+  for (uint16 i = 1; i < 4; i++) {
+    record.mem[i] = mmu->read(addr + i, Component::Debug);
   }
+  tracer->push();
 }
 
-uint16
-CPU::readRegister(uint16& reg, RegisterBits register_bits)
+void
+CPU::trackIdleLoop()
 {
-  switch (register_bits) {
-    case RegisterBits::High:
-      return (reg >> 8) & 0x00FF;
-    case RegisterBits::Low:
-      return reg & 0x00FF;
-    case RegisterBits::Full:
-      return reg;
-  }
-  log_error("CPU reading unknown bits from register.");
-  return reg;
+  // a loop head is the target of a short backwards jump
+  uint16 addr = PC - 1;
+  bool backwards = addr <= idle_last_addr && idle_last_addr - addr < 64;
+  idle_last_addr = addr;
+  if (!backwards) {
+    return;
+  }
+  uint16 registers[5] = { currentAF(), BC, DE, HL, SP };
+  if (addr == idle_head && idle_clean && idle_ime == ime &&
+      std::equal(registers, registers + 5, idle_registers)) {
+    idle_found = true;
+    idle_loop = idle_reads;
+    idle_loop.cycles = idle_cycles;
+  }
+  idle_head = addr;
+  idle_clean = true;
+  idle_cycles = 0;
+  std::copy(registers, registers + 5, idle_registers);
+  idle_ime = ime;
+  idle_reads.reads = 0;
+}
+
+void
+CPU::trackIdleRead(uint16 addr)
+{
+  if (mmu->isDmaActive()) {
+    idle_clean = false;
+    return;
+  }
+  bool is_io = addr >= 0xFF00 && addr < HramStart;
+  bool is_vram_or_oam = (addr >= 0x8000 && addr < 0xA000) ||
+                        (addr >= 0xFE00 && addr < 0xFF00);
+  if (is_vram_or_oam) {
+    // what can be read depends on the ppu mode
+    idle_clean = false;
+    return;
+  }
+  if (!is_io) {
+    // memory only changes through writes
+    return;
+  }
+  if (addr != 0xFF04 && addr != IFRAddr && addr != 0xFF41 && addr != 0xFF44) {
+    idle_clean = false;
+    return;
+  }
+  for (uint8 i = 0; i < idle_reads.reads; i++) {
+    if (idle_reads.addr[i] == addr) {
+      idle_clean = idle_reads.value[i] == ioData;
+      return;
+    }
+  }
+  if (idle_reads.reads == IdleLoopInfo::MaxReads) {
+    idle_clean = false;
+    return;
+  }
+  idle_reads.addr[idle_reads.reads] = addr;
+  idle_reads.value[idle_reads.reads] = ioData;
+  idle_reads.reads++;
 }
 
 void
 CPU::setFlag(FlagBits flag, bool value)
 {
+  materializeFlags();
   if (value) {
     AF |= static_cast<uint16>(flag);
   } else {
@@ -351,9 +411,175 @@ CPU::setFlag(FlagBits flag, bool value)
 bool
 CPU::getFlag(FlagBits flag)
 {
+  materializeFlags();
   return (AF & static_cast<uint16>(flag)) != 0;
 }
 
+void
+CPU::materializeFlags()
+{
+  if (flag_op == FlagOp::None) {
+    return;
+  }
+  uint8 f = lazyFlags(flag_op, flag_lhs, flag_rhs, flag_carry, flag_result);
+  if (verify_flags && f != verify_f) {
+    log_error("Lazy flags 0x%02X of op %d on 0x%02X, 0x%02X with carry %d "
+              "don't match the eager 0x%02X",
+              f,
+              static_cast<int>(flag_op),
+              flag_lhs,
+              flag_rhs,
+              flag_carry,
+              verify_f);
+    abort();
+  }
+  AF = (AF & 0xFF00) | f;
+  flag_op = FlagOp::None;
+}
+
+uint16
+CPU::currentAF() const
+{
+  if (flag_op == FlagOp::None) {
+    return AF;
+  }
+  return (AF & 0xFF00) |
+         lazyFlags(flag_op, flag_lhs, flag_rhs, flag_carry, flag_result);
+}
+
+uint8
+CPU::lazyFlags(FlagOp op, uint8 lhs, uint8 rhs, uint8 carry, uint8 result)
+{
+  uint8 f = result == 0 ? static_cast<uint8>(FlagBits::Zero) : 0;
+  // bit 4 of the operands and result differs when the low nibble carried
+  uint8 half_carry = ((lhs ^ rhs ^ result) & 0x10) << 1;
+  switch (op) {
+    case FlagOp::Add:
+      f |= half_carry;
+      if (lhs + rhs + carry > 0xFF) {
+        f |= static_cast<uint8>(FlagBits::Carry);
+      }
+      break;
+    case FlagOp::Sub:
+      f |= static_cast<uint8>(FlagBits::Subtract) | half_carry;
+      if (lhs < rhs + carry) {
+        f |= static_cast<uint8>(FlagBits::Carry);
+      }
+      break;
+    case FlagOp::And:
+      f |= static_cast<uint8>(FlagBits::HalfCarry);
+      break;
+    case FlagOp::Or:
+    case FlagOp::Xor:
+    case FlagOp::None:
+      break;
+  }
+  return f;
+}
+
+uint8
+CPU::eagerFlags(FlagOp op, uint8 lhs, uint8 rhs, uint8 carry)
+{
+  // the way the alu instructions used to set them
+  uint8 result = 0;
+  bool subtract = false;
+  bool half_carry = false;
+  bool carry_out = false;
+  switch (op) {
+    case FlagOp::Add:
+      result = lhs + rhs + carry;
+      half_carry = ((lhs & 0x0F) + (rhs & 0x0F) + carry) > 0x0F;
+      carry_out = (lhs + rhs + carry) > 0xFF;
+      break;
+    case FlagOp::Sub:
+      result = lhs - rhs - carry;
+      subtract = true;
+      half_carry = (lhs & 0x0F) < ((rhs & 0x0F) + carry);
+      carry_out = lhs < (rhs + carry);
+      break;
+    case FlagOp::And:
+      result = lhs & rhs;
+      half_carry = true;
+      break;
+    case FlagOp::Or:
+      result = lhs | rhs;
+      break;
+    case FlagOp::Xor:
+      result = lhs ^ rhs;
+      break;
+    case FlagOp::None:
+      break;
+  }
+  uint8 f = 0;
+  f |= result == 0 ? static_cast<uint8>(FlagBits::Zero) : 0;
+  f |= subtract ? static_cast<uint8>(FlagBits::Subtract) : 0;
+  f |= half_carry ? static_cast<uint8>(FlagBits::HalfCarry) : 0;
+  f |= carry_out ? static_cast<uint8>(FlagBits::Carry) : 0;
+  return f;
+}
+
+bool
+CPU::verifyLazyFlags()
+{
+  const FlagOp ops[] = {
+    FlagOp::Add, FlagOp::Sub, FlagOp::And, FlagOp::Or, FlagOp::Xor
+  };
+  for (FlagOp op : ops) {
+    uint8 carries = op == FlagOp::Add || op == FlagOp::Sub ? 2 : 1;
+    for (uint32 lhs = 0; lhs < 256; lhs++) {
+      for (uint32 rhs = 0; rhs < 256; rhs++) {
+        for (uint8 carry = 0; carry < carries; carry++) {
+          uint8 result = 0;
+          switch (op) {
+            case FlagOp::Add:
+              result = lhs + rhs + carry;
+              break;
+            case FlagOp::Sub:
+              result = lhs - rhs - carry;
+              break;
+            case FlagOp::And:
+              result = lhs & rhs;
+              break;
+            case FlagOp::Or:
+              result = lhs | rhs;
+              break;
+            case FlagOp::Xor:
+              result = lhs ^ rhs;
+              break;
+            case FlagOp::None:
+              break;
+          }
+          uint8 lazy = lazyFlags(op, lhs, rhs, carry, result);
+          uint8 eager = eagerFlags(op, lhs, rhs, carry);
+          if (lazy != eager) {
+            log_error("Lazy flags 0x%02X of op %d on 0x%02X, 0x%02X with "
+                      "carry %d don't match the eager 0x%02X",
+                      lazy,
+                      static_cast<int>(op),
+                      lhs,
+                      rhs,
+                      carry,
+                      eager);
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void
+CPU::setFlagVerification(bool enabled)
+{
+  if (enabled && !verifyLazyFlags()) {
+    abort();
+  }
+  // an op recorded before has no eager flags to compare with
+  materializeFlags();
+  verify_flags = enabled;
+}
+
 bool
 CPU::checkCondition(Condition flag)
 {
@@ -372,7 +598,7 @@ CPU::checkCondition(Condition flag)
 }
 
 uint8
-CPU::getInterrupts()
+CPU::getInterrupts() const
 {
   // only the first 5 bits are used
   return IER & IFR & 0x1F;
@@ -402,18 +628,18 @@ CPU::serviceInterrupt()
       instruction_cycles++;
       break;
     case 2:
-      write(SP, (uint8)readRegister(PC, RegisterBits::High));
+      write(SP, PC >> 8);
       iduDec(SP);
       instruction_cycles++;
       break;
     case 3:
-      write(SP, (uint8)readRegister(PC, RegisterBits::Low));
+      write(SP, PC & 0xFF);
       for (const auto& [bit, vector] : interrupt_vectors) {
         if ((getInterrupts() & bit) != 0) {
           // clear the interrupt flag
           log_debug("Servicing interrupt 0x%X", vector);
           IFR &= ~bit;
-          setRegister(PC, vector, RegisterBits::Full);
+          PC = vector;
         }
       }
       instruction_cycles++;
@@ -1,27 +1,35 @@
 #include "cpu.h"
+#include "mmu.h"
 
 void
 CPU::next()
 {
+  if (curr_block != nullptr && mmu->hasQuietReads()) {
+    uint16 offset = PC - curr_block->start;
+    if (offset < curr_block->bytes.size()) {
+      // fetched when the block was decoded, writes to it drop the block
+      ioData = curr_block->bytes[offset];
+      iduInc(PC);
+      return;
+    }
+  }
   read(PC);
   iduInc(PC);
 }
 
 // load instructions
+template<CPU::Reg8 D, CPU::Reg8 S>
 void
-CPU::ld_r8_r8(uint16& regD,
-              CPU::RegisterBits regDB,
-              uint16& regS,
-              CPU::RegisterBits regSB)
+CPU::ld_r8_r8()
 {
-  uint16 sourceValue = readRegister(regS, regSB);
-  setRegister(regD, sourceValue, regDB);
+  r8<D>() = r8<S>();
   log_debug("ld_r8_r8");
   next();
 }
 
+template<CPU::Reg8 D>
 void
-CPU::ld_r8_n8(uint16& regD, CPU::RegisterBits regB)
+CPU::ld_r8_n8()
 {
   switch (instruction_cycles) {
     case 0:
@@ -29,7 +37,7 @@ CPU::ld_r8_n8(uint16& regD, CPU::RegisterBits regB)
       next();
       break;
     case 1:
-      setRegister(regD, ioData, regB);
+      r8<D>() = ioData;
       log_debug("ld_r8_n8 0x%X", ioData);
       next();
       instruction_cycles = 0;
@@ -51,7 +59,7 @@ CPU::ld_r16_n16(uint16& regD)
       next();
       break;
     case 2:
-      setRegister(regD, (ioData << 8) | lowByte, RegisterBits::Full);
+      regD = (ioData << 8) | lowByte;
       log_debug("ld_r16_n16 0x%X", (ioData << 8) | lowByte);
       next();
       instruction_cycles = 0;
@@ -59,12 +67,13 @@ CPU::ld_r16_n16(uint16& regD)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::ld_ar16_r8(uint16& regD, uint16& regS, CPU::RegisterBits regSB)
+CPU::ld_ar16_r8(uint16& regD)
 {
   switch (instruction_cycles) {
     case 0:
-      write(regD, (uint8)readRegister(regS, regSB));
+      write(regD, r8<S>());
       instruction_cycles++;
       break;
     case 1:
@@ -95,8 +104,9 @@ CPU::ld_ar16_n8(uint16& regD)
   }
 }
 
+template<CPU::Reg8 D>
 void
-CPU::ld_r8_ar16(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
+CPU::ld_r8_ar16(uint16& regS)
 {
   switch (instruction_cycles) {
     case 0:
@@ -104,7 +114,7 @@ CPU::ld_r8_ar16(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
       instruction_cycles++;
       break;
     case 1:
-      setRegister(regD, ioData, regDB);
+      r8<D>() = ioData;
       instruction_cycles = 0;
       next();
       log_debug("ld_r8_ar16");
@@ -112,8 +122,9 @@ CPU::ld_r8_ar16(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::ld_a16_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::ld_a16_r8()
 {
   switch (instruction_cycles) {
     case 0:
@@ -126,7 +137,7 @@ CPU::ld_a16_r8(uint16& regS, CPU::RegisterBits regSB)
       next();
       break;
     case 2:
-      write((ioData << 8) | lowByte, (uint8)readRegister(regS, regSB));
+      write((ioData << 8) | lowByte, r8<S>());
       log_debug("ld_a16_r8 0x%X", (ioData << 8) | lowByte);
       instruction_cycles++;
       break;
@@ -137,8 +148,9 @@ CPU::ld_a16_r8(uint16& regS, CPU::RegisterBits regSB)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::ldh_a8_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::ldh_a8_r8()
 {
   switch (instruction_cycles) {
     case 0:
@@ -146,7 +158,7 @@ CPU::ldh_a8_r8(uint16& regS, CPU::RegisterBits regSB)
       next();
       break;
     case 1:
-      write(0xFF00 + ioData, (uint8)readRegister(regS, regSB));
+      write(0xFF00 + ioData, r8<S>());
       log_debug("ldh_a8_r8 0x%X", ioData);
       instruction_cycles++;
       break;
@@ -157,16 +169,13 @@ CPU::ldh_a8_r8(uint16& regS, CPU::RegisterBits regSB)
   }
 }
 
+template<CPU::Reg8 D, CPU::Reg8 S>
 void
-CPU::ldh_ar8_r8(uint16& regD,
-                CPU::RegisterBits regDB,
-                uint16& regS,
-                CPU::RegisterBits regSB)
+CPU::ldh_ar8_r8()
 {
   switch (instruction_cycles) {
     case 0:
-      write(0xFF00 + readRegister(regD, regDB),
-            (uint8)readRegister(regS, regSB));
+      write(0xFF00 + r8<D>(), r8<S>());
       instruction_cycles++;
       break;
     case 1:
@@ -177,8 +186,9 @@ CPU::ldh_ar8_r8(uint16& regD,
   }
 }
 
+template<CPU::Reg8 D>
 void
-CPU::ld_r8_a16(uint16& regD, CPU::RegisterBits regDB)
+CPU::ld_r8_a16()
 {
   switch (instruction_cycles) {
     case 0:
@@ -196,15 +206,16 @@ CPU::ld_r8_a16(uint16& regD, CPU::RegisterBits regDB)
       instruction_cycles++;
       break;
     case 3:
-      setRegister(regD, ioData, regDB);
+      r8<D>() = ioData;
       instruction_cycles = 0;
       next();
       break;
   }
 }
 
+template<CPU::Reg8 D>
 void
-CPU::ldh_r8_a8(uint16& regD, CPU::RegisterBits regDB)
+CPU::ldh_r8_a8()
 {
   switch (instruction_cycles) {
     case 0:
@@ -217,26 +228,24 @@ CPU::ldh_r8_a8(uint16& regD, CPU::RegisterBits regDB)
       instruction_cycles++;
       break;
     case 2:
-      setRegister(regD, ioData, regDB);
+      r8<D>() = ioData;
       instruction_cycles = 0;
       next();
       break;
   }
 }
 
+template<CPU::Reg8 D, CPU::Reg8 S>
 void
-CPU::ldh_r8_ar8(uint16& regD,
-                CPU::RegisterBits regDB,
-                uint16& regS,
-                CPU::RegisterBits regSB)
+CPU::ldh_r8_ar8()
 {
   switch (instruction_cycles) {
     case 0:
-      read(0xFF00 + readRegister(regS, regSB));
+      read(0xFF00 + r8<S>());
       instruction_cycles++;
       break;
     case 1:
-      setRegister(regD, ioData, regDB);
+      r8<D>() = ioData;
       instruction_cycles = 0;
       next();
       log_debug("ldh_r8_ar8");
@@ -244,12 +253,13 @@ CPU::ldh_r8_ar8(uint16& regD,
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::ld_ar16i_r8(uint16& regD, uint16& regS, CPU::RegisterBits regSB)
+CPU::ld_ar16i_r8(uint16& regD)
 {
   switch (instruction_cycles) {
     case 0:
-      write(regD, (uint8)readRegister(regS, regSB));
+      write(regD, r8<S>());
       iduInc(regD);
       instruction_cycles++;
       break;
@@ -261,12 +271,13 @@ CPU::ld_ar16i_r8(uint16& regD, uint16& regS, CPU::RegisterBits regSB)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::ld_ar16d_r8(uint16& regD, uint16& regS, CPU::RegisterBits regSB)
+CPU::ld_ar16d_r8(uint16& regD)
 {
   switch (instruction_cycles) {
     case 0:
-      write(regD, (uint8)readRegister(regS, regSB));
+      write(regD, r8<S>());
       iduDec(regD);
       instruction_cycles++;
       break;
@@ -278,8 +289,9 @@ CPU::ld_ar16d_r8(uint16& regD, uint16& regS, CPU::RegisterBits regSB)
   }
 }
 
+template<CPU::Reg8 D>
 void
-CPU::ld_r8_ar16i(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
+CPU::ld_r8_ar16i(uint16& regS)
 {
   switch (instruction_cycles) {
     case 0:
@@ -288,7 +300,7 @@ CPU::ld_r8_ar16i(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
       instruction_cycles++;
       break;
     case 1:
-      setRegister(regD, ioData, regDB);
+      r8<D>() = ioData;
       instruction_cycles = 0;
       next();
       log_debug("ld_r8_ar16i");
@@ -296,8 +308,9 @@ CPU::ld_r8_ar16i(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
   }
 }
 
+template<CPU::Reg8 D>
 void
-CPU::ld_r8_ar16d(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
+CPU::ld_r8_ar16d(uint16& regS)
 {
   switch (instruction_cycles) {
     case 0:
@@ -306,7 +319,7 @@ CPU::ld_r8_ar16d(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
       instruction_cycles++;
       break;
     case 1:
-      setRegister(regD, ioData, regDB);
+      r8<D>() = ioData;
       instruction_cycles = 0;
       next();
       log_debug("ld_r8_ar16d");
@@ -316,21 +329,24 @@ CPU::ld_r8_ar16d(uint16& regD, CPU::RegisterBits regDB, uint16& regS)
 
 // arithmetic instructions
 void
-CPU::adc_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_adc(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
+  uint8 val1 = r8<Reg8::A>();
   uint8 carry = getFlag(FlagBits::Carry) ? 1 : 0;
   uint8 result = val1 + val2 + carry;
-  setRegister(AF, result, RegisterBits::High);
-  setFlag(FlagBits::Zero, result == 0);
-  setFlag(FlagBits::Subtract, false);
-  setFlag(FlagBits::HalfCarry, ((val1 & 0x0F) + (val2 & 0x0F) + carry) > 0x0F);
-  setFlag(FlagBits::Carry, (val1 + val2 + carry) > 0xFF);
+  r8<Reg8::A>() = result;
+  setLazyFlags(FlagOp::Add, val1, val2, carry, result);
   next();
   log_debug("adc_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::adc_r8()
+{
+  alu_adc(r8<S>()); // next is called in alu_adc
+}
+
 void
 CPU::adc_ar16(uint16& regS)
 {
@@ -343,7 +359,7 @@ CPU::adc_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("adc_ar16 [ignore next log]");
-      adc_r8(tmp, RegisterBits::Low); // next is called in adc_r8
+      alu_adc(tmp); // next is called in alu_adc
       instruction_cycles = 0;
       break;
   }
@@ -361,27 +377,30 @@ CPU::adc_n8()
     case 1:
       tmp = ioData;
       log_debug("adc_n8 0x%X [ignore next log]", tmp);
-      adc_r8(tmp, RegisterBits::Low); // next is called in adc_r8
+      alu_adc(tmp); // next is called in alu_adc
       instruction_cycles = 0;
       break;
   }
 }
 
 void
-CPU::add_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_add(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
+  uint8 val1 = r8<Reg8::A>();
   uint8 result = val1 + val2;
-  setRegister(AF, result, RegisterBits::High);
-  setFlag(FlagBits::Zero, result == 0);
-  setFlag(FlagBits::Subtract, false);
-  setFlag(FlagBits::HalfCarry, ((val1 & 0x0F) + (val2 & 0x0F)) > 0x0F);
-  setFlag(FlagBits::Carry, (val1 + val2) > 0xFF);
+  r8<Reg8::A>() = result;
+  setLazyFlags(FlagOp::Add, val1, val2, 0, result);
   next();
   log_debug("add_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::add_r8()
+{
+  alu_add(r8<S>()); // next is called in alu_add
+}
+
 void
 CPU::add_ar16(uint16& regS)
 {
@@ -394,7 +413,7 @@ CPU::add_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("add_ar16 [ignore next log]");
-      add_r8(tmp, RegisterBits::Low); // next is called in add_r8
+      alu_add(tmp); // next is called in alu_add
       instruction_cycles = 0;
       break;
   }
@@ -412,25 +431,28 @@ CPU::add_n8()
     case 1:
       tmp = ioData;
       log_debug("add_n8 0x%X [ignore next log]", tmp);
-      add_r8(tmp, RegisterBits::Low); // next is called in add_r8
+      alu_add(tmp); // next is called in alu_add
       instruction_cycles = 0;
       break;
   }
 }
 
 void
-CPU::cp_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_cp(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
-  setFlag(FlagBits::Zero, val1 == val2);
-  setFlag(FlagBits::Subtract, true);
-  setFlag(FlagBits::HalfCarry, (val1 & 0x0F) < (val2 & 0x0F));
-  setFlag(FlagBits::Carry, val1 < val2);
+  uint8 val1 = r8<Reg8::A>();
+  setLazyFlags(FlagOp::Sub, val1, val2, 0, val1 - val2);
   next();
   log_debug("cp_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::cp_r8()
+{
+  alu_cp(r8<S>()); // next is called in alu_cp
+}
+
 void
 CPU::cp_ar16(uint16& regS)
 {
@@ -443,7 +465,7 @@ CPU::cp_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("cp_ar16 [ignore next log]");
-      cp_r8(tmp, RegisterBits::Low); // next is called in cp_r8
+      alu_cp(tmp); // next is called in alu_cp
       instruction_cycles = 0;
       break;
   }
@@ -461,18 +483,19 @@ CPU::cp_n8()
     case 1:
       tmp = ioData;
       log_debug("cp_n8 0x%X [ignore next log]", tmp);
-      cp_r8(tmp, RegisterBits::Low); // next is called in cp_r8
+      alu_cp(tmp); // next is called in alu_cp
       instruction_cycles = 0;
       break;
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::dec_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::dec_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   uint8 result = val - 1;
-  setRegister(regS, result, regSB);
+  r8<S>() = result;
   setFlag(FlagBits::Zero, result == 0);
   setFlag(FlagBits::Subtract, true);
   setFlag(FlagBits::HalfCarry, (val & 0x0F) == 0);
@@ -503,12 +526,13 @@ CPU::dec_ar16(uint16& regS)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::inc_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::inc_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   uint8 result = val + 1;
-  setRegister(regS, result, regSB);
+  r8<S>() = result;
   setFlag(FlagBits::Zero, result == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, (val & 0x0F) == 0x0F);
@@ -540,21 +564,24 @@ CPU::inc_ar16(uint16& regS)
 }
 
 void
-CPU::sbc_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_sbc(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
+  uint8 val1 = r8<Reg8::A>();
   uint8 carry = getFlag(FlagBits::Carry) ? 1 : 0;
   uint8 result = val1 - val2 - carry;
-  setRegister(AF, result, RegisterBits::High);
-  setFlag(FlagBits::Zero, result == 0);
-  setFlag(FlagBits::Subtract, true);
-  setFlag(FlagBits::HalfCarry, (val1 & 0x0F) < ((val2 & 0x0F) + carry));
-  setFlag(FlagBits::Carry, val1 < (val2 + carry));
+  r8<Reg8::A>() = result;
+  setLazyFlags(FlagOp::Sub, val1, val2, carry, result);
   next();
   log_debug("sbc_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::sbc_r8()
+{
+  alu_sbc(r8<S>()); // next is called in alu_sbc
+}
+
 void
 CPU::sbc_ar16(uint16& regS)
 {
@@ -567,7 +594,7 @@ CPU::sbc_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("sbc_ar16 [ignore next log]");
-      sbc_r8(tmp, RegisterBits::Low); // next is called in sbc_r8
+      alu_sbc(tmp); // next is called in alu_sbc
       instruction_cycles = 0;
       break;
   }
@@ -585,27 +612,30 @@ CPU::sbc_n8()
     case 1:
       tmp = ioData;
       log_debug("sbc_n8 0x%X [ignore next log]", tmp);
-      sbc_r8(tmp, RegisterBits::Low); // next is called in sbc_r8
+      alu_sbc(tmp); // next is called in alu_sbc
       instruction_cycles = 0;
       break;
   }
 }
 
 void
-CPU::sub_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_sub(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
+  uint8 val1 = r8<Reg8::A>();
   uint8 result = val1 - val2;
-  setRegister(AF, result, RegisterBits::High);
-  setFlag(FlagBits::Zero, result == 0);
-  setFlag(FlagBits::Subtract, true);
-  setFlag(FlagBits::HalfCarry, (val1 & 0x0F) < (val2 & 0x0F));
-  setFlag(FlagBits::Carry, val1 < val2);
+  r8<Reg8::A>() = result;
+  setLazyFlags(FlagOp::Sub, val1, val2, 0, result);
   next();
   log_debug("sub_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::sub_r8()
+{
+  alu_sub(r8<S>()); // next is called in alu_sub
+}
+
 void
 CPU::sub_ar16(uint16& regS)
 {
@@ -618,7 +648,7 @@ CPU::sub_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("sub_ar16 [ignore next log]");
-      sub_r8(tmp, RegisterBits::Low); // next is called in sub_r8
+      alu_sub(tmp); // next is called in alu_sub
       instruction_cycles = 0;
       break;
   }
@@ -636,7 +666,7 @@ CPU::sub_n8()
     case 1:
       tmp = ioData;
       log_debug("sub_n8 0x%X [ignore next log]", tmp);
-      sub_r8(tmp, RegisterBits::Low); // next is called in sub_r8
+      alu_sub(tmp); // next is called in alu_sub
       instruction_cycles = 0;
       break;
   }
@@ -650,10 +680,10 @@ CPU::add_r16_r16(uint16& regD, uint16& regS)
   uint16 result = 0;
   switch (instruction_cycles) {
     case 0:
-      val1 = readRegister(regD, RegisterBits::Full);
-      val2 = readRegister(regS, RegisterBits::Full);
+      val1 = regD;
+      val2 = regS;
       result = val1 + val2;
-      setRegister(regD, result, RegisterBits::Full);
+      regD = result;
       setFlag(FlagBits::Subtract, false);
       setFlag(FlagBits::HalfCarry,
               ((val1 & 0x0FFF) + (val2 & 0x0FFF)) > 0x0FFF);
@@ -702,20 +732,23 @@ CPU::inc_r16(uint16& regS)
 
 // bitwise logic instructions
 void
-CPU::and_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_and(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
+  uint8 val1 = r8<Reg8::A>();
   uint8 result = val1 & val2;
-  setRegister(AF, result, RegisterBits::High);
-  setFlag(FlagBits::Zero, result == 0);
-  setFlag(FlagBits::Subtract, false);
-  setFlag(FlagBits::HalfCarry, true);
-  setFlag(FlagBits::Carry, false);
+  r8<Reg8::A>() = result;
+  setLazyFlags(FlagOp::And, val1, val2, 0, result);
   next();
   log_debug("and_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::and_r8()
+{
+  alu_and(r8<S>()); // next is called in alu_and
+}
+
 void
 CPU::and_ar16(uint16& regS)
 {
@@ -728,7 +761,7 @@ CPU::and_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("and_ar16 [ignore next log]");
-      and_r8(tmp, RegisterBits::Low); // next is called in and_r8
+      alu_and(tmp); // next is called in alu_and
       instruction_cycles = 0;
       break;
   }
@@ -746,7 +779,7 @@ CPU::and_n8()
     case 1:
       tmp = ioData;
       log_debug("and_n8 0x%X [ignore next log]", tmp);
-      and_r8(tmp, RegisterBits::Low); // next is called in and_r8
+      alu_and(tmp); // next is called in alu_and
       instruction_cycles = 0;
       break;
   }
@@ -755,9 +788,9 @@ CPU::and_n8()
 void
 CPU::cpl()
 {
-  uint8 val = readRegister(AF, RegisterBits::High);
+  uint8 val = r8<Reg8::A>();
   val = ~val;
-  setRegister(AF, val, RegisterBits::High);
+  r8<Reg8::A>() = val;
   setFlag(FlagBits::Subtract, true);
   setFlag(FlagBits::HalfCarry, true);
   next();
@@ -765,20 +798,23 @@ CPU::cpl()
 }
 
 void
-CPU::or_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_or(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
+  uint8 val1 = r8<Reg8::A>();
   uint8 result = val1 | val2;
-  setRegister(AF, result, RegisterBits::High);
-  setFlag(FlagBits::Zero, result == 0);
-  setFlag(FlagBits::Subtract, false);
-  setFlag(FlagBits::HalfCarry, false);
-  setFlag(FlagBits::Carry, false);
+  r8<Reg8::A>() = result;
+  setLazyFlags(FlagOp::Or, val1, val2, 0, result);
   next();
   log_debug("or_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::or_r8()
+{
+  alu_or(r8<S>()); // next is called in alu_or
+}
+
 void
 CPU::or_ar16(uint16& regS)
 {
@@ -791,7 +827,7 @@ CPU::or_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("or_ar16 [ignore next log]");
-      or_r8(tmp, RegisterBits::Low); // next is called in or_r8
+      alu_or(tmp); // next is called in alu_or
       instruction_cycles = 0;
       break;
   }
@@ -809,27 +845,30 @@ CPU::or_n8()
     case 1:
       tmp = ioData;
       log_debug("or_n8 0x%X [ignore next log]", tmp);
-      or_r8(tmp, RegisterBits::Low); // next is called in or_r8
+      alu_or(tmp); // next is called in alu_or
       instruction_cycles = 0;
       break;
   }
 }
 
 void
-CPU::xor_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::alu_xor(uint8 val2)
 {
-  uint8 val1 = readRegister(AF, RegisterBits::High);
-  uint8 val2 = readRegister(regS, regSB);
+  uint8 val1 = r8<Reg8::A>();
   uint8 result = val1 ^ val2;
-  setRegister(AF, result, RegisterBits::High);
-  setFlag(FlagBits::Zero, result == 0);
-  setFlag(FlagBits::Subtract, false);
-  setFlag(FlagBits::HalfCarry, false);
-  setFlag(FlagBits::Carry, false);
+  r8<Reg8::A>() = result;
+  setLazyFlags(FlagOp::Xor, val1, val2, 0, result);
   next();
   log_debug("xor_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::xor_r8()
+{
+  alu_xor(r8<S>()); // next is called in alu_xor
+}
+
 void
 CPU::xor_ar16(uint16& regS)
 {
@@ -842,7 +881,7 @@ CPU::xor_ar16(uint16& regS)
     case 1:
       tmp = ioData;
       log_debug("xor_ar16 [ignore next log]");
-      xor_r8(tmp, RegisterBits::Low); // next is called in xor_r8
+      alu_xor(tmp); // next is called in alu_xor
       instruction_cycles = 0;
       break;
   }
@@ -860,7 +899,7 @@ CPU::xor_n8()
     case 1:
       tmp = ioData;
       log_debug("xor_n8 0x%X [ignore next log]", tmp);
-      xor_r8(tmp, RegisterBits::Low); // next is called in xor_r8
+      alu_xor(tmp); // next is called in alu_xor
       instruction_cycles = 0;
       break;
   }
@@ -868,9 +907,8 @@ CPU::xor_n8()
 
 // bit manipulation instructions
 void
-CPU::bit_r8(uint16& regS, CPU::RegisterBits regSB, uint8 bit)
+CPU::alu_bit(uint8 val, uint8 bit)
 {
-  uint8 val = readRegister(regS, regSB);
   setFlag(FlagBits::Zero, (val & (1 << bit)) == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, true);
@@ -878,6 +916,13 @@ CPU::bit_r8(uint16& regS, CPU::RegisterBits regSB, uint8 bit)
   log_debug("bit_r8");
 }
 
+template<CPU::Reg8 S>
+void
+CPU::bit_r8(uint8 bit)
+{
+  alu_bit(r8<S>(), bit); // next is called in alu_bit
+}
+
 void
 CPU::bit_ar16(uint16& regS, uint8 bit)
 {
@@ -890,18 +935,19 @@ CPU::bit_ar16(uint16& regS, uint8 bit)
     case 1:
       tmp = ioData;
       log_debug("bit_ar16 [ignore next log]");
-      bit_r8(tmp, RegisterBits::Low, bit); // next is called in bit_r8
+      alu_bit(tmp, bit); // next is called in alu_bit
       instruction_cycles = 0;
       break;
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::res_r8(uint16& regS, CPU::RegisterBits regSB, uint8 bit)
+CPU::res_r8(uint8 bit)
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   val &= ~(1 << bit);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   next();
   log_debug("res_r8");
 }
@@ -928,12 +974,13 @@ CPU::res_ar16(uint16& regS, uint8 bit)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::set_r8(uint16& regS, CPU::RegisterBits regSB, uint8 bit)
+CPU::set_r8(uint8 bit)
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   val |= (1 << bit);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   next();
   log_debug("set_r8");
 }
@@ -961,14 +1008,15 @@ CPU::set_ar16(uint16& regS, uint8 bit)
 }
 
 // bit shift instructions
+template<CPU::Reg8 S>
 void
-CPU::rl_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::rl_r8()
 {
   bool carry = getFlag(FlagBits::Carry);
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   bool newCarry = (val & 0x80) != 0;
   val = (val << 1) | (carry ? 1 : 0);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1012,10 +1060,10 @@ void
 CPU::rla()
 {
   bool carry = getFlag(FlagBits::Carry);
-  uint8 val = readRegister(AF, RegisterBits::High);
+  uint8 val = r8<Reg8::A>();
   bool newCarry = (val & 0x80) != 0;
   val = (val << 1) | (carry ? 1 : 0);
-  setRegister(AF, val, RegisterBits::High);
+  r8<Reg8::A>() = val;
   setFlag(FlagBits::Zero, false);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1024,13 +1072,14 @@ CPU::rla()
   log_debug("rla");
 }
 
+template<CPU::Reg8 S>
 void
-CPU::rlc_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::rlc_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   bool newCarry = (val & 0x80) != 0;
   val = (val << 1) | (newCarry ? 1 : 0);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1071,10 +1120,10 @@ CPU::rlc_ar16(uint16& regS)
 void
 CPU::rlca()
 {
-  uint8 val = readRegister(AF, RegisterBits::High);
+  uint8 val = r8<Reg8::A>();
   bool newCarry = (val & 0x80) != 0;
   val = (val << 1) | (newCarry ? 1 : 0);
-  setRegister(AF, val, RegisterBits::High);
+  r8<Reg8::A>() = val;
   setFlag(FlagBits::Zero, false);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1083,14 +1132,15 @@ CPU::rlca()
   log_debug("rlca");
 }
 
+template<CPU::Reg8 S>
 void
-CPU::rr_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::rr_r8()
 {
   bool carry = getFlag(FlagBits::Carry);
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   bool newCarry = (val & 0x01) != 0;
   val = (val >> 1) | (carry ? 0x80 : 0);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1133,11 +1183,11 @@ CPU::rr_ar16(uint16& regS)
 void
 CPU::rra()
 {
-  uint8 val = readRegister(AF, RegisterBits::High);
+  uint8 val = r8<Reg8::A>();
   bool carry = getFlag(FlagBits::Carry);
   bool newCarry = (val & 0x01) != 0;
   val = (val >> 1) | (carry ? 0x80 : 0);
-  setRegister(AF, val, RegisterBits::High);
+  r8<Reg8::A>() = val;
   setFlag(FlagBits::Zero, false);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1146,13 +1196,14 @@ CPU::rra()
   log_debug("rra");
 }
 
+template<CPU::Reg8 S>
 void
-CPU::rrc_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::rrc_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   bool newCarry = (val & 0x01) != 0;
   val = (val >> 1) | (newCarry ? 0x80 : 0);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1193,10 +1244,10 @@ CPU::rrc_ar16(uint16& regS)
 void
 CPU::rrca()
 {
-  uint8 val = readRegister(AF, RegisterBits::High);
+  uint8 val = r8<Reg8::A>();
   bool newCarry = (val & 0x01) != 0;
   val = (val >> 1) | (newCarry ? 0x80 : 0);
-  setRegister(AF, val, RegisterBits::High);
+  r8<Reg8::A>() = val;
   setFlag(FlagBits::Zero, false);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1205,13 +1256,14 @@ CPU::rrca()
   log_debug("rrca");
 }
 
+template<CPU::Reg8 S>
 void
-CPU::sla_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::sla_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   bool newCarry = (val & 0x80) != 0;
   val = val << 1;
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1249,13 +1301,14 @@ CPU::sla_ar16(uint16& regS)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::sra_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::sra_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   bool newCarry = (val & 0x01) != 0;
   val = (val >> 1) | (val & 0x80);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1293,13 +1346,14 @@ CPU::sra_ar16(uint16& regS)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::srl_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::srl_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   bool newCarry = (val & 0x01) != 0;
   val = val >> 1;
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1337,12 +1391,13 @@ CPU::srl_ar16(uint16& regS)
   }
 }
 
+template<CPU::Reg8 S>
 void
-CPU::swap_r8(uint16& regS, CPU::RegisterBits regSB)
+CPU::swap_r8()
 {
-  uint8 val = readRegister(regS, regSB);
+  uint8 val = r8<S>();
   val = (val << 4) | (val >> 4);
-  setRegister(regS, val, regSB);
+  r8<S>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Subtract, false);
   setFlag(FlagBits::HalfCarry, false);
@@ -1398,18 +1453,13 @@ CPU::call_a16()
       instruction_cycles++;
       break;
     case 3:
-      write(
-        SP,
-        (uint8)readRegister(PC, RegisterBits::High)); // push high byte of PC
+      write(SP, PC >> 8); // push high byte of PC
       iduDec(SP);
       instruction_cycles++;
       break;
     case 4:
-      write(SP,
-            (uint8)readRegister(PC, RegisterBits::Low)); // push low byte of PC
-      setRegister(PC,
-                  (highByte << 8) | lowByte,
-                  RegisterBits::Full); // set PC to new address
+      write(SP, PC & 0xFF); // push low byte of PC
+      PC = (highByte << 8) | lowByte; // set PC to new address
       instruction_cycles++;
       break;
     case 5:
@@ -1445,18 +1495,13 @@ CPU::call_cc(Condition flag)
       }
       break;
     case 3:
-      write(
-        SP,
-        (uint8)readRegister(PC, RegisterBits::High)); // push high byte of PC
+      write(SP, PC >> 8); // push high byte of PC
       iduDec(SP);
       instruction_cycles++;
       break;
     case 4:
-      write(SP,
-            (uint8)readRegister(PC, RegisterBits::Low)); // push low byte of PC
-      setRegister(PC,
-                  (highByte << 8) | lowByte,
-                  RegisterBits::Full); // set PC to new address
+      write(SP, PC & 0xFF); // push low byte of PC
+      PC = (highByte << 8) | lowByte; // set PC to new address
       instruction_cycles++;
       break;
     case 5:
@@ -1470,7 +1515,7 @@ CPU::call_cc(Condition flag)
 void
 CPU::jp_r16(uint16& regS)
 {
-  setRegister(PC, regS, RegisterBits::Full);
+  PC = regS;
   next();
   log_debug("jp_r16");
 }
@@ -1489,7 +1534,7 @@ CPU::jp_a16()
       next();
       break;
     case 2:
-      setRegister(PC, (ioData << 8) | lowByte, RegisterBits::Full);
+      PC = (ioData << 8) | lowByte;
       instruction_cycles++;
       break;
     case 3:
@@ -1515,7 +1560,7 @@ CPU::jp_cc_a16(Condition flag)
       break;
     case 2:
       if (checkCondition(flag)) {
-        setRegister(PC, (ioData << 8) | lowByte, RegisterBits::Full);
+        PC = (ioData << 8) | lowByte;
         instruction_cycles++;
       } else {
         instruction_cycles = 0;
@@ -1542,7 +1587,7 @@ CPU::jr_a8()
       break;
     case 1:
       new_addr = (int16)PC + (int8)ioData;
-      setRegister(PC, new_addr, RegisterBits::Full);
+      PC = new_addr;
       instruction_cycles++;
       break;
     case 2:
@@ -1564,7 +1609,7 @@ CPU::jr_cc_a8(Condition flag)
     case 1:
       if (checkCondition(flag)) {
         int16 new_addr = (int16)PC + (int8)ioData;
-        setRegister(PC, new_addr, RegisterBits::Full);
+        PC = new_addr;
         instruction_cycles++;
       } else {
         instruction_cycles = 0;
@@ -1605,7 +1650,7 @@ CPU::ret_cc(Condition flag)
       instruction_cycles++;
       break;
     case 3:
-      setRegister(PC, (ioData << 8) | lowByte, RegisterBits::Full);
+      PC = (ioData << 8) | lowByte;
       instruction_cycles++;
       break;
     case 4:
@@ -1632,7 +1677,7 @@ CPU::ret()
       instruction_cycles++;
       break;
     case 2:
-      setRegister(PC, (ioData << 8) | lowByte, RegisterBits::Full);
+      PC = (ioData << 8) | lowByte;
       instruction_cycles++;
       break;
     case 3:
@@ -1659,7 +1704,7 @@ CPU::reti()
       instruction_cycles++;
       break;
     case 2:
-      setRegister(PC, (ioData << 8) | lowByte, RegisterBits::Full);
+      PC = (ioData << 8) | lowByte;
       ime = Ime::Enable;
       instruction_cycles++;
       break;
@@ -1680,17 +1725,13 @@ CPU::rst()
       instruction_cycles++;
       break;
     case 1:
-      write(
-        SP,
-        (uint8)readRegister(PC, RegisterBits::High)); // push high byte of PC
+      write(SP, PC >> 8); // push high byte of PC
       iduDec(SP);
       instruction_cycles++;
       break;
     case 2:
-      write(SP,
-            (uint8)readRegister(PC, RegisterBits::Low)); // push low byte of PC
-      setRegister(
-        PC, curr_opcode & 0x38, RegisterBits::Full); // set PC to new address
+      write(SP, PC & 0xFF); // push low byte of PC
+      PC = curr_opcode & 0x38; // set PC to new address
       instruction_cycles++;
       break;
     case 3:
@@ -1741,7 +1782,7 @@ CPU::add_sp_e8()
       setFlag(FlagBits::Subtract, false);
       setFlag(FlagBits::HalfCarry, ((SP & 0x0F) + ((uint16)val & 0x0F)) > 0x0F);
       setFlag(FlagBits::Carry, ((SP & 0xFF) + ((uint16)val & 0xFF)) > 0xFF);
-      setRegister(SP, result, RegisterBits::Full);
+      SP = result;
       instruction_cycles++;
       break;
     case 2:
@@ -1770,14 +1811,11 @@ CPU::ld_a16_sp()
       break;
     case 2:
       highByte = ioData;
-      write((highByte << 8) | lowByte,
-            (uint8)readRegister(SP, RegisterBits::Low)); // write low byte of SP
+      write((highByte << 8) | lowByte, SP & 0xFF); // write low byte of SP
       instruction_cycles++;
       break;
     case 3:
-      write(
-        ((highByte << 8) | lowByte) + 1,
-        (uint8)readRegister(SP, RegisterBits::High)); // write high byte of SP
+      write(((highByte << 8) | lowByte) + 1, SP >> 8); // write high byte of SP
       instruction_cycles++;
       break;
     case 4:
@@ -1801,7 +1839,7 @@ CPU::ld_hl_sp_e8()
     case 1:
       val = (int8)ioData;
       result = (int16)SP + (int16)val;
-      setRegister(HL, result, RegisterBits::Full);
+      HL = result;
       setFlag(FlagBits::Zero, false);
       setFlag(FlagBits::Subtract, false);
       setFlag(FlagBits::HalfCarry, ((SP & 0x0F) + ((uint16)val & 0x0F)) > 0x0F);
@@ -1819,11 +1857,9 @@ CPU::ld_hl_sp_e8()
 void
 CPU::ld_r16_r16(uint16& regD, uint16& regS)
 {
-  uint16 val = 0;
   switch (instruction_cycles) {
     case 0:
-      val = readRegister(regS, RegisterBits::Full);
-      setRegister(regD, val, RegisterBits::Full);
+      regD = regS;
       instruction_cycles++;
       break;
     case 1:
@@ -1850,7 +1886,13 @@ CPU::pop_r16(uint16& regS)
       instruction_cycles++;
       break;
     case 2:
-      setRegister(regS, (ioData << 8) | lowByte, RegisterBits::Full);
+      if (&regS == &AF) {
+        // lowest 4 bits of F don't exist
+        AF = ((ioData << 8) | lowByte) & 0xFFF0;
+        flag_op = FlagOp::None;
+      } else {
+        regS = (ioData << 8) | lowByte;
+      }
       instruction_cycles = 0;
       next();
       log_debug("pop_r16");
@@ -1867,14 +1909,16 @@ CPU::push_r16(uint16& regS)
       instruction_cycles++;
       break;
     case 1:
-      write(SP,
-            (uint8)(readRegister(regS, RegisterBits::High))); // push high byte
+      write(SP, regS >> 8); // push high byte
       iduDec(SP);
       instruction_cycles++;
       break;
     case 2:
-      write(SP,
-            (uint8)(readRegister(regS, RegisterBits::Low))); // push low byte
+      if (&regS == &AF) {
+        // F has to hold the flags of the last alu op
+        materializeFlags();
+      }
+      write(SP, regS & 0xFF); // push low byte
       instruction_cycles++;
       break;
     case 3:
@@ -1924,7 +1968,7 @@ CPU::halt()
 void
 CPU::daa()
 {
-  uint8 val = readRegister(AF, RegisterBits::High);
+  uint8 val = r8<Reg8::A>();
   bool carry = getFlag(FlagBits::Carry);
   bool halfCarry = getFlag(FlagBits::HalfCarry);
   bool subtract = getFlag(FlagBits::Subtract);
@@ -1944,7 +1988,7 @@ CPU::daa()
       val -= 0x06;
     }
   }
-  setRegister(AF, val, RegisterBits::High);
+  r8<Reg8::A>() = val;
   setFlag(FlagBits::Zero, val == 0);
   setFlag(FlagBits::Carry, carry);
   setFlag(FlagBits::HalfCarry, false);
@@ -1974,3 +2018,375 @@ CPU::prefix_cb()
   next();
   log_debug("prefix_cb");
 }
+
+// opcode tables, bound here so every templated handler is instantiated in
+// the translation unit that defines it
+std::unordered_map<uint8, std::function<void()>>
+CPU::bindOpcodes()
+{
+  return {
+    { 0x00, std::bind(&CPU::nop, this) },
+    { 0x01, std::bind(&CPU::ld_r16_n16, this, std::ref(BC)) },
+    { 0x02, std::bind(&CPU::ld_ar16_r8<Reg8::A>, this, std::ref(BC)) },
+    { 0x03, std::bind(&CPU::inc_r16, this, std::ref(BC)) },
+    { 0x04, std::bind(&CPU::inc_r8<Reg8::B>, this) },
+    { 0x05, std::bind(&CPU::dec_r8<Reg8::B>, this) },
+    { 0x06, std::bind(&CPU::ld_r8_n8<Reg8::B>, this) },
+    { 0x07, std::bind(&CPU::rlca, this) },
+    { 0x08, std::bind(&CPU::ld_a16_sp, this) },
+    { 0x09, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(BC)) },
+    { 0x0A, std::bind(&CPU::ld_r8_ar16<Reg8::A>, this, std::ref(BC)) },
+    { 0x0B, std::bind(&CPU::dec_r16, this, std::ref(BC)) },
+    { 0x0C, std::bind(&CPU::inc_r8<Reg8::C>, this) },
+    { 0x0D, std::bind(&CPU::dec_r8<Reg8::C>, this) },
+    { 0x0E, std::bind(&CPU::ld_r8_n8<Reg8::C>, this) },
+    { 0x0F, std::bind(&CPU::rrca, this) },
+
+    { 0x10, std::bind(&CPU::stop, this) },
+    { 0x11, std::bind(&CPU::ld_r16_n16, this, std::ref(DE)) },
+    { 0x12, std::bind(&CPU::ld_ar16_r8<Reg8::A>, this, std::ref(DE)) },
+    { 0x13, std::bind(&CPU::inc_r16, this, std::ref(DE)) },
+    { 0x14, std::bind(&CPU::inc_r8<Reg8::D>, this) },
+    { 0x15, std::bind(&CPU::dec_r8<Reg8::D>, this) },
+    { 0x16, std::bind(&CPU::ld_r8_n8<Reg8::D>, this) },
+    { 0x17, std::bind(&CPU::rla, this) },
+    { 0x18, std::bind(&CPU::jr_a8, this) },
+    { 0x19, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(DE)) },
+    { 0x1A, std::bind(&CPU::ld_r8_ar16<Reg8::A>, this, std::ref(DE)) },
+    { 0x1B, std::bind(&CPU::dec_r16, this, std::ref(DE)) },
+    { 0x1C, std::bind(&CPU::inc_r8<Reg8::E>, this) },
+    { 0x1D, std::bind(&CPU::dec_r8<Reg8::E>, this) },
+    { 0x1E, std::bind(&CPU::ld_r8_n8<Reg8::E>, this) },
+    { 0x1F, std::bind(&CPU::rra, this) },
+
+    { 0x20, std::bind(&CPU::jr_cc_a8, this, Condition::NotZero) },
+    { 0x21, std::bind(&CPU::ld_r16_n16, this, std::ref(HL)) },
+    { 0x22, std::bind(&CPU::ld_ar16i_r8<Reg8::A>, this, std::ref(HL)) },
+    { 0x23, std::bind(&CPU::inc_r16, this, std::ref(HL)) },
+    { 0x24, std::bind(&CPU::inc_r8<Reg8::H>, this) },
+    { 0x25, std::bind(&CPU::dec_r8<Reg8::H>, this) },
+    { 0x26, std::bind(&CPU::ld_r8_n8<Reg8::H>, this) },
+    { 0x27, std::bind(&CPU::daa, this) },
+    { 0x28, std::bind(&CPU::jr_cc_a8, this, Condition::Zero) },
+    { 0x29, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(HL)) },
+    { 0x2A, std::bind(&CPU::ld_r8_ar16i<Reg8::A>, this, std::ref(HL)) },
+    { 0x2B, std::bind(&CPU::dec_r16, this, std::ref(HL)) },
+    { 0x2C, std::bind(&CPU::inc_r8<Reg8::L>, this) },
+    { 0x2D, std::bind(&CPU::dec_r8<Reg8::L>, this) },
+    { 0x2E, std::bind(&CPU::ld_r8_n8<Reg8::L>, this) },
+    { 0x2F, std::bind(&CPU::cpl, this) },
+
+    { 0x30, std::bind(&CPU::jr_cc_a8, this, Condition::NotCarry) },
+    { 0x31, std::bind(&CPU::ld_r16_n16, this, std::ref(SP)) },
+    { 0x32, std::bind(&CPU::ld_ar16d_r8<Reg8::A>, this, std::ref(HL)) },
+    { 0x33, std::bind(&CPU::inc_r16, this, std::ref(SP)) },
+    { 0x34, std::bind(&CPU::inc_ar16, this, std::ref(HL)) },
+    { 0x35, std::bind(&CPU::dec_ar16, this, std::ref(HL)) },
+    { 0x36, std::bind(&CPU::ld_ar16_n8, this, std::ref(HL)) },
+    { 0x37, std::bind(&CPU::scf, this) },
+    { 0x38, std::bind(&CPU::jr_cc_a8, this, Condition::Carry) },
+    { 0x39, std::bind(&CPU::add_r16_r16, this, std::ref(HL), std::ref(SP)) },
+    { 0x3A, std::bind(&CPU::ld_r8_ar16d<Reg8::A>, this, std::ref(HL)) },
+    { 0x3B, std::bind(&CPU::dec_r16, this, std::ref(SP)) },
+    { 0x3C, std::bind(&CPU::inc_r8<Reg8::A>, this) },
+    { 0x3D, std::bind(&CPU::dec_r8<Reg8::A>, this) },
+    { 0x3E, std::bind(&CPU::ld_r8_n8<Reg8::A>, this) },
+    { 0x3F, std::bind(&CPU::ccf, this) },
+
+    { 0x40, std::bind(&CPU::ld_r8_r8<Reg8::B, Reg8::B>, this) },
+    { 0x41, std::bind(&CPU::ld_r8_r8<Reg8::B, Reg8::C>, this) },
+    { 0x42, std::bind(&CPU::ld_r8_r8<Reg8::B, Reg8::D>, this) },
+    { 0x43, std::bind(&CPU::ld_r8_r8<Reg8::B, Reg8::E>, this) },
+    { 0x44, std::bind(&CPU::ld_r8_r8<Reg8::B, Reg8::H>, this) },
+    { 0x45, std::bind(&CPU::ld_r8_r8<Reg8::B, Reg8::L>, this) },
+    { 0x46, std::bind(&CPU::ld_r8_ar16<Reg8::B>, this, std::ref(HL)) },
+    { 0x47, std::bind(&CPU::ld_r8_r8<Reg8::B, Reg8::A>, this) },
+    { 0x48, std::bind(&CPU::ld_r8_r8<Reg8::C, Reg8::B>, this) },
+    { 0x49, std::bind(&CPU::ld_r8_r8<Reg8::C, Reg8::C>, this) },
+    { 0x4A, std::bind(&CPU::ld_r8_r8<Reg8::C, Reg8::D>, this) },
+    { 0x4B, std::bind(&CPU::ld_r8_r8<Reg8::C, Reg8::E>, this) },
+    { 0x4C, std::bind(&CPU::ld_r8_r8<Reg8::C, Reg8::H>, this) },
+    { 0x4D, std::bind(&CPU::ld_r8_r8<Reg8::C, Reg8::L>, this) },
+    { 0x4E, std::bind(&CPU::ld_r8_ar16<Reg8::C>, this, std::ref(HL)) },
+    { 0x4F, std::bind(&CPU::ld_r8_r8<Reg8::C, Reg8::A>, this) },
+
+    { 0x50, std::bind(&CPU::ld_r8_r8<Reg8::D, Reg8::B>, this) },
+    { 0x51, std::bind(&CPU::ld_r8_r8<Reg8::D, Reg8::C>, this) },
+    { 0x52, std::bind(&CPU::ld_r8_r8<Reg8::D, Reg8::D>, this) },
+    { 0x53, std::bind(&CPU::ld_r8_r8<Reg8::D, Reg8::E>, this) },
+    { 0x54, std::bind(&CPU::ld_r8_r8<Reg8::D, Reg8::H>, this) },
+    { 0x55, std::bind(&CPU::ld_r8_r8<Reg8::D, Reg8::L>, this) },
+    { 0x56, std::bind(&CPU::ld_r8_ar16<Reg8::D>, this, std::ref(HL)) },
+    { 0x57, std::bind(&CPU::ld_r8_r8<Reg8::D, Reg8::A>, this) },
+    { 0x58, std::bind(&CPU::ld_r8_r8<Reg8::E, Reg8::B>, this) },
+    { 0x59, std::bind(&CPU::ld_r8_r8<Reg8::E, Reg8::C>, this) },
+    { 0x5A, std::bind(&CPU::ld_r8_r8<Reg8::E, Reg8::D>, this) },
+    { 0x5B, std::bind(&CPU::ld_r8_r8<Reg8::E, Reg8::E>, this) },
+    { 0x5C, std::bind(&CPU::ld_r8_r8<Reg8::E, Reg8::H>, this) },
+    { 0x5D, std::bind(&CPU::ld_r8_r8<Reg8::E, Reg8::L>, this) },
+    { 0x5E, std::bind(&CPU::ld_r8_ar16<Reg8::E>, this, std::ref(HL)) },
+    { 0x5F, std::bind(&CPU::ld_r8_r8<Reg8::E, Reg8::A>, this) },
+
+    { 0x60, std::bind(&CPU::ld_r8_r8<Reg8::H, Reg8::B>, this) },
+    { 0x61, std::bind(&CPU::ld_r8_r8<Reg8::H, Reg8::C>, this) },
+    { 0x62, std::bind(&CPU::ld_r8_r8<Reg8::H, Reg8::D>, this) },
+    { 0x63, std::bind(&CPU::ld_r8_r8<Reg8::H, Reg8::E>, this) },
+    { 0x64, std::bind(&CPU::ld_r8_r8<Reg8::H, Reg8::H>, this) },
+    { 0x65, std::bind(&CPU::ld_r8_r8<Reg8::H, Reg8::L>, this) },
+    { 0x66, std::bind(&CPU::ld_r8_ar16<Reg8::H>, this, std::ref(HL)) },
+    { 0x67, std::bind(&CPU::ld_r8_r8<Reg8::H, Reg8::A>, this) },
+    { 0x68, std::bind(&CPU::ld_r8_r8<Reg8::L, Reg8::B>, this) },
+    { 0x69, std::bind(&CPU::ld_r8_r8<Reg8::L, Reg8::C>, this) },
+    { 0x6A, std::bind(&CPU::ld_r8_r8<Reg8::L, Reg8::D>, this) },
+    { 0x6B, std::bind(&CPU::ld_r8_r8<Reg8::L, Reg8::E>, this) },
+    { 0x6C, std::bind(&CPU::ld_r8_r8<Reg8::L, Reg8::H>, this) },
+    { 0x6D, std::bind(&CPU::ld_r8_r8<Reg8::L, Reg8::L>, this) },
+    { 0x6E, std::bind(&CPU::ld_r8_ar16<Reg8::L>, this, std::ref(HL)) },
+    { 0x6F, std::bind(&CPU::ld_r8_r8<Reg8::L, Reg8::A>, this) },
+
+    { 0x70, std::bind(&CPU::ld_ar16_r8<Reg8::B>, this, std::ref(HL)) },
+    { 0x71, std::bind(&CPU::ld_ar16_r8<Reg8::C>, this, std::ref(HL)) },
+    { 0x72, std::bind(&CPU::ld_ar16_r8<Reg8::D>, this, std::ref(HL)) },
+    { 0x73, std::bind(&CPU::ld_ar16_r8<Reg8::E>, this, std::ref(HL)) },
+    { 0x74, std::bind(&CPU::ld_ar16_r8<Reg8::H>, this, std::ref(HL)) },
+    { 0x75, std::bind(&CPU::ld_ar16_r8<Reg8::L>, this, std::ref(HL)) },
+    { 0x76, std::bind(&CPU::halt, this) },
+    { 0x77, std::bind(&CPU::ld_ar16_r8<Reg8::A>, this, std::ref(HL)) },
+    { 0x78, std::bind(&CPU::ld_r8_r8<Reg8::A, Reg8::B>, this) },
+    { 0x79, std::bind(&CPU::ld_r8_r8<Reg8::A, Reg8::C>, this) },
+    { 0x7A, std::bind(&CPU::ld_r8_r8<Reg8::A, Reg8::D>, this) },
+    { 0x7B, std::bind(&CPU::ld_r8_r8<Reg8::A, Reg8::E>, this) },
+    { 0x7C, std::bind(&CPU::ld_r8_r8<Reg8::A, Reg8::H>, this) },
+    { 0x7D, std::bind(&CPU::ld_r8_r8<Reg8::A, Reg8::L>, this) },
+    { 0x7E, std::bind(&CPU::ld_r8_ar16<Reg8::A>, this, std::ref(HL)) },
+    { 0x7F, std::bind(&CPU::ld_r8_r8<Reg8::A, Reg8::A>, this) },
+
+    { 0x80, std::bind(&CPU::add_r8<Reg8::B>, this) },
+    { 0x81, std::bind(&CPU::add_r8<Reg8::C>, this) },
+    { 0x82, std::bind(&CPU::add_r8<Reg8::D>, this) },
+    { 0x83, std::bind(&CPU::add_r8<Reg8::E>, this) },
+    { 0x84, std::bind(&CPU::add_r8<Reg8::H>, this) },
+    { 0x85, std::bind(&CPU::add_r8<Reg8::L>, this) },
+    { 0x86, std::bind(&CPU::add_ar16, this, std::ref(HL)) },
+    { 0x87, std::bind(&CPU::add_r8<Reg8::A>, this) },
+    { 0x88, std::bind(&CPU::adc_r8<Reg8::B>, this) },
+    { 0x89, std::bind(&CPU::adc_r8<Reg8::C>, this) },
+    { 0x8A, std::bind(&CPU::adc_r8<Reg8::D>, this) },
+    { 0x8B, std::bind(&CPU::adc_r8<Reg8::E>, this) },
+    { 0x8C, std::bind(&CPU::adc_r8<Reg8::H>, this) },
+    { 0x8D, std::bind(&CPU::adc_r8<Reg8::L>, this) },
+    { 0x8E, std::bind(&CPU::adc_ar16, this, std::ref(HL)) },
+    { 0x8F, std::bind(&CPU::adc_r8<Reg8::A>, this) },
+
+    { 0x90, std::bind(&CPU::sub_r8<Reg8::B>, this) },
+    { 0x91, std::bind(&CPU::sub_r8<Reg8::C>, this) },
+    { 0x92, std::bind(&CPU::sub_r8<Reg8::D>, this) },
+    { 0x93, std::bind(&CPU::sub_r8<Reg8::E>, this) },
+    { 0x94, std::bind(&CPU::sub_r8<Reg8::H>, this) },
+    { 0x95, std::bind(&CPU::sub_r8<Reg8::L>, this) },
+    { 0x96, std::bind(&CPU::sub_ar16, this, std::ref(HL)) },
+    { 0x97, std::bind(&CPU::sub_r8<Reg8::A>, this) },
+    { 0x98, std::bind(&CPU::sbc_r8<Reg8::B>, this) },
+    { 0x99, std::bind(&CPU::sbc_r8<Reg8::C>, this) },
+    { 0x9A, std::bind(&CPU::sbc_r8<Reg8::D>, this) },
+    { 0x9B, std::bind(&CPU::sbc_r8<Reg8::E>, this) },
+    { 0x9C, std::bind(&CPU::sbc_r8<Reg8::H>, this) },
+    { 0x9D, std::bind(&CPU::sbc_r8<Reg8::L>, this) },
+    { 0x9E, std::bind(&CPU::sbc_ar16, this, std::ref(HL)) },
+    { 0x9F, std::bind(&CPU::sbc_r8<Reg8::A>, this) },
+
+    { 0xA0, std::bind(&CPU::and_r8<Reg8::B>, this) },
+    { 0xA1, std::bind(&CPU::and_r8<Reg8::C>, this) },
+    { 0xA2, std::bind(&CPU::and_r8<Reg8::D>, this) },
+    { 0xA3, std::bind(&CPU::and_r8<Reg8::E>, this) },
+    { 0xA4, std::bind(&CPU::and_r8<Reg8::H>, this) },
+    { 0xA5, std::bind(&CPU::and_r8<Reg8::L>, this) },
+    { 0xA6, std::bind(&CPU::and_ar16, this, std::ref(HL)) },
+    { 0xA7, std::bind(&CPU::and_r8<Reg8::A>, this) },
+    { 0xA8, std::bind(&CPU::xor_r8<Reg8::B>, this) },
+    { 0xA9, std::bind(&CPU::xor_r8<Reg8::C>, this) },
+    { 0xAA, std::bind(&CPU::xor_r8<Reg8::D>, this) },
+    { 0xAB, std::bind(&CPU::xor_r8<Reg8::E>, this) },
+    { 0xAC, std::bind(&CPU::xor_r8<Reg8::H>, this) },
+    { 0xAD, std::bind(&CPU::xor_r8<Reg8::L>, this) },
+    { 0xAE, std::bind(&CPU::xor_ar16, this, std::ref(HL)) },
+    { 0xAF, std::bind(&CPU::xor_r8<Reg8::A>, this) },
+
+    { 0xB0, std::bind(&CPU::or_r8<Reg8::B>, this) },
+    { 0xB1, std::bind(&CPU::or_r8<Reg8::C>, this) },
+    { 0xB2, std::bind(&CPU::or_r8<Reg8::D>, this) },
+    { 0xB3, std::bind(&CPU::or_r8<Reg8::E>, this) },
+    { 0xB4, std::bind(&CPU::or_r8<Reg8::H>, this) },
+    { 0xB5, std::bind(&CPU::or_r8<Reg8::L>, this) },
+    { 0xB6, std::bind(&CPU::or_ar16, this, std::ref(HL)) },
+    { 0xB7, std::bind(&CPU::or_r8<Reg8::A>, this) },
+    { 0xB8, std::bind(&CPU::cp_r8<Reg8::B>, this) },
+    { 0xB9, std::bind(&CPU::cp_r8<Reg8::C>, this) },
+    { 0xBA, std::bind(&CPU::cp_r8<Reg8::D>, this) },
+    { 0xBB, std::bind(&CPU::cp_r8<Reg8::E>, this) },
+    { 0xBC, std::bind(&CPU::cp_r8<Reg8::H>, this) },
+    { 0xBD, std::bind(&CPU::cp_r8<Reg8::L>, this) },
+    { 0xBE, std::bind(&CPU::cp_ar16, this, std::ref(HL)) },
+    { 0xBF, std::bind(&CPU::cp_r8<Reg8::A>, this) },
+
+    { 0xC0, std::bind(&CPU::ret_cc, this, Condition::NotZero) },
+    { 0xC1, std::bind(&CPU::pop_r16, this, std::ref(BC)) },
+    { 0xC2, std::bind(&CPU::jp_cc_a16, this, Condition::NotZero) },
+    { 0xC3, std::bind(&CPU::jp_a16, this) },
+    { 0xC4, std::bind(&CPU::call_cc, this, Condition::NotZero) },
+    { 0xC5, std::bind(&CPU::push_r16, this, std::ref(BC)) },
+    { 0xC6, std::bind(&CPU::add_n8, this) },
+    { 0xC7, std::bind(&CPU::rst, this) },
+    { 0xC8, std::bind(&CPU::ret_cc, this, Condition::Zero) },
+    { 0xC9, std::bind(&CPU::ret, this) },
+    { 0xCA, std::bind(&CPU::jp_cc_a16, this, Condition::Zero) },
+    { 0xCB, std::bind(&CPU::prefix_cb, this) },
+    { 0xCC, std::bind(&CPU::call_cc, this, Condition::Zero) },
+    { 0xCD, std::bind(&CPU::call_a16, this) },
+    { 0xCE, std::bind(&CPU::adc_n8, this) },
+    { 0xCF, std::bind(&CPU::rst, this) },
+
+    { 0xD0, std::bind(&CPU::ret_cc, this, Condition::NotCarry) },
+    { 0xD1, std::bind(&CPU::pop_r16, this, std::ref(DE)) },
+    { 0xD2, std::bind(&CPU::jp_cc_a16, this, Condition::NotCarry) },
+    { 0xD4, std::bind(&CPU::call_cc, this, Condition::NotCarry) },
+    { 0xD5, std::bind(&CPU::push_r16, this, std::ref(DE)) },
+    { 0xD6, std::bind(&CPU::sub_n8, this) },
+    { 0xD7, std::bind(&CPU::rst, this) },
+    { 0xD8, std::bind(&CPU::ret_cc, this, Condition::Carry) },
+    { 0xD9, std::bind(&CPU::reti, this) },
+    { 0xDA, std::bind(&CPU::jp_cc_a16, this, Condition::Carry) },
+    { 0xDC, std::bind(&CPU::call_cc, this, Condition::Carry) },
+    { 0xDE, std::bind(&CPU::sbc_n8, this) },
+    { 0xDF, std::bind(&CPU::rst, this) },
+
+    { 0xE0, std::bind(&CPU::ldh_a8_r8<Reg8::A>, this) },
+    { 0xE1, std::bind(&CPU::pop_r16, this, std::ref(HL)) },
+    { 0xE2, std::bind(&CPU::ldh_ar8_r8<Reg8::C, Reg8::A>, this) },
+    { 0xE5, std::bind(&CPU::push_r16, this, std::ref(HL)) },
+    { 0xE6, std::bind(&CPU::and_n8, this) },
+    { 0xE7, std::bind(&CPU::rst, this) },
+    { 0xE8, std::bind(&CPU::add_sp_e8, this) },
+    { 0xE9, std::bind(&CPU::jp_r16, this, std::ref(HL)) },
+    { 0xEA, std::bind(&CPU::ld_a16_r8<Reg8::A>, this) },
+    { 0xEE, std::bind(&CPU::xor_n8, this) },
+    { 0xEF, std::bind(&CPU::rst, this) },
+
+    { 0xF0, std::bind(&CPU::ldh_r8_a8<Reg8::A>, this) },
+    { 0xF1, std::bind(&CPU::pop_r16, this, std::ref(AF)) },
+    { 0xF2, std::bind(&CPU::ldh_r8_ar8<Reg8::A, Reg8::C>, this) },
+    { 0xF3, std::bind(&CPU::di, this) },
+    { 0xF5, std::bind(&CPU::push_r16, this, std::ref(AF)) },
+    { 0xF6, std::bind(&CPU::or_n8, this) },
+    { 0xF7, std::bind(&CPU::rst, this) },
+    { 0xF8, std::bind(&CPU::ld_hl_sp_e8, this) },
+    { 0xF9, std::bind(&CPU::ld_r16_r16, this, std::ref(SP), std::ref(HL)) },
+    { 0xFA, std::bind(&CPU::ld_r8_a16<Reg8::A>, this) },
+    { 0xFB, std::bind(&CPU::ei, this) },
+    { 0xFE, std::bind(&CPU::cp_n8, this) },
+    { 0xFF, std::bind(&CPU::rst, this) },
+  };
+}
+
+template<CPU::Reg8 R>
+std::function<void()>
+CPU::bindPrefix(uint8 opcode)
+{
+  uint8 index_val = (opcode >> 3) & 0x7;
+  switch (opcode & 0xC0) {
+    case 0x00:
+      switch (index_val) {
+        case 0:
+          return std::bind(&CPU::rlc_r8<R>, this);
+        case 1:
+          return std::bind(&CPU::rrc_r8<R>, this);
+        case 2:
+          return std::bind(&CPU::rl_r8<R>, this);
+        case 3:
+          return std::bind(&CPU::rr_r8<R>, this);
+        case 4:
+          return std::bind(&CPU::sla_r8<R>, this);
+        case 5:
+          return std::bind(&CPU::sra_r8<R>, this);
+        case 6:
+          return std::bind(&CPU::swap_r8<R>, this);
+        case 7:
+          return std::bind(&CPU::srl_r8<R>, this);
+      }
+      break;
+    case 0x40:
+      return std::bind(&CPU::bit_r8<R>, this, index_val);
+    case 0x80:
+      return std::bind(&CPU::res_r8<R>, this, index_val);
+    case 0xC0:
+      return std::bind(&CPU::set_r8<R>, this, index_val);
+  }
+  return nullptr;
+}
+
+std::function<void()>
+CPU::fetchPrefixInstruction(uint8 opcode)
+{
+  std::function<void()> instr = nullptr;
+  uint8 index_val = (opcode >> 3) & 0x7;
+
+  switch (opcode & 0x7) {
+    case 0:
+      return bindPrefix<Reg8::B>(opcode);
+    case 1:
+      return bindPrefix<Reg8::C>(opcode);
+    case 2:
+      return bindPrefix<Reg8::D>(opcode);
+    case 3:
+      return bindPrefix<Reg8::E>(opcode);
+    case 4:
+      return bindPrefix<Reg8::H>(opcode);
+    case 5:
+      return bindPrefix<Reg8::L>(opcode);
+    case 7:
+      return bindPrefix<Reg8::A>(opcode);
+  }
+
+  // the operand is (hl)
+  switch (opcode & 0xC0) {
+    case 0x00:
+      switch (index_val) {
+        case 0:
+          instr = std::bind(&CPU::rlc_ar16, this, std::ref(HL));
+          break;
+        case 1:
+          instr = std::bind(&CPU::rrc_ar16, this, std::ref(HL));
+          break;
+        case 2:
+          instr = std::bind(&CPU::rl_ar16, this, std::ref(HL));
+          break;
+        case 3:
+          instr = std::bind(&CPU::rr_ar16, this, std::ref(HL));
+          break;
+        case 4:
+          instr = std::bind(&CPU::sla_ar16, this, std::ref(HL));
+          break;
+        case 5:
+          instr = std::bind(&CPU::sra_ar16, this, std::ref(HL));
+          break;
+        case 6:
+          instr = std::bind(&CPU::swap_ar16, this, std::ref(HL));
+          break;
+        case 7:
+          instr = std::bind(&CPU::srl_ar16, this, std::ref(HL));
+          break;
+      }
+      break;
+    case 0x40:
+      instr = std::bind(&CPU::bit_ar16, this, std::ref(HL), index_val);
+      break;
+    case 0x80:
+      instr = std::bind(&CPU::res_ar16, this, std::ref(HL), index_val);
+      break;
+    case 0xC0:
+      instr = std::bind(&CPU::set_ar16, this, std::ref(HL), index_val);
+      break;
+  }
+
+  return instr;
+}
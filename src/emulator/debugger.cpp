@@ -0,0 +1,574 @@
+#include "debugger.h"
+#include "cpu.h"
+#include "mmu.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// n8 immediate byte, n16 and a16 immediate word, a8 high page address,
+// e8 relative jump and s8 signed immediate
+const char* const Opcodes[256] = {
+  // 0x00
+  "nop", "ld bc, n16", "ld [bc], a", "inc bc", "inc b", "dec b", "ld b, n8",
+  "rlca", "ld [a16], sp", "add hl, bc", "ld a, [bc]", "dec bc", "inc c",
+  "dec c", "ld c, n8", "rrca",
+  // 0x10
+  "stop", "ld de, n16", "ld [de], a", "inc de", "inc d", "dec d", "ld d, n8",
+  "rla", "jr e8", "add hl, de", "ld a, [de]", "dec de", "inc e", "dec e",
+  "ld e, n8", "rra",
+  // 0x20
+  "jr nz, e8", "ld hl, n16", "ld [hli], a", "inc hl", "inc h", "dec h",
+  "ld h, n8", "daa", "jr z, e8", "add hl, hl", "ld a, [hli]", "dec hl", "inc l",
+  "dec l", "ld l, n8", "cpl",
+  // 0x30
+  "jr nc, e8", "ld sp, n16", "ld [hld], a", "inc sp", "inc [hl]", "dec [hl]",
+  "ld [hl], n8", "scf", "jr c, e8", "add hl, sp", "ld a, [hld]", "dec sp",
+  "inc a", "dec a", "ld a, n8", "ccf",
+  // 0x40 - 0xBF are generated
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  // 0xC0
+  "ret nz", "pop bc", "jp nz, a16", "jp a16", "call nz, a16", "push bc",
+  "add a, n8", "rst $00", "ret z", "ret", "jp z, a16", "prefix", "call z, a16",
+  "call a16", "adc a, n8", "rst $08",
+  // 0xD0
+  "ret nc", "pop de", "jp nc, a16", nullptr, "call nc, a16", "push de",
+  "sub a, n8", "rst $10", "ret c", "reti", "jp c, a16", nullptr, "call c, a16",
+  nullptr, "sbc a, n8", "rst $18",
+  // 0xE0
+  "ldh [a8], a", "pop hl", "ldh [c], a", nullptr, nullptr, "push hl",
+  "and a, n8", "rst $20", "add sp, s8", "jp hl", "ld [a16], a", nullptr,
+  nullptr, nullptr, "xor a, n8", "rst $28",
+  // 0xF0
+  "ldh a, [a8]", "pop af", "ldh a, [c]", "di", nullptr, "push af", "or a, n8",
+  "rst $30", "ld hl, sp + s8", "ld sp, hl", "ld a, [a16]", "ei", nullptr,
+  nullptr, "cp a, n8", "rst $38",
+};
+
+const char* const Registers[8] = { "b", "c", "d", "e", "h", "l", "[hl]", "a" };
+const char* const AluOps[8] = { "add a,", "adc a,", "sub a,", "sbc a,",
+                                "and a,", "xor a,", "or a,",  "cp a," };
+const char* const ShiftOps[8] = { "rlc", "rrc", "rl",   "rr",
+                                  "sla", "sra", "swap", "srl" };
+
+const std::pair<const char*, uint16> IoRegisters[] = {
+  { "P1", 0xFF00 },   { "SB", 0xFF01 },   { "SC", 0xFF02 },
+  { "DIV", 0xFF04 },  { "TIMA", 0xFF05 }, { "TMA", 0xFF06 },
+  { "TAC", 0xFF07 },  { "IF", 0xFF0F },   { "NR10", 0xFF10 },
+  { "NR11", 0xFF11 }, { "NR12", 0xFF12 }, { "NR13", 0xFF13 },
+  { "NR14", 0xFF14 }, { "NR21", 0xFF16 }, { "NR22", 0xFF17 },
+  { "NR23", 0xFF18 }, { "NR24", 0xFF19 }, { "NR30", 0xFF1A },
+  { "NR31", 0xFF1B }, { "NR32", 0xFF1C }, { "NR33", 0xFF1D },
+  { "NR34", 0xFF1E }, { "NR41", 0xFF20 }, { "NR42", 0xFF21 },
+  { "NR43", 0xFF22 }, { "NR44", 0xFF23 }, { "NR50", 0xFF24 },
+  { "NR51", 0xFF25 }, { "NR52", 0xFF26 }, { "LCDC", 0xFF40 },
+  { "STAT", 0xFF41 }, { "SCY", 0xFF42 },  { "SCX", 0xFF43 },
+  { "LY", 0xFF44 },   { "LYC", 0xFF45 },  { "DMA", 0xFF46 },
+  { "BGP", 0xFF47 },  { "OBP0", 0xFF48 }, { "OBP1", 0xFF49 },
+  { "WY", 0xFF4A },   { "WX", 0xFF4B },   { "IE", 0xFFFF },
+};
+
+const char*
+ioName(uint16 addr)
+{
+  for (const auto& [name, io_addr] : IoRegisters) {
+    if (io_addr == addr) {
+      return name;
+    }
+  }
+  return nullptr;
+}
+
+std::string
+format(const char* fmt, int32 value)
+{
+  char text[32];
+  std::snprintf(text, sizeof(text), fmt, value);
+  return text;
+}
+
+bool
+parseNumber(const std::string& text, uint32& value, int base)
+{
+  if (text.empty()) {
+    return false;
+  }
+  const char* start = text.c_str();
+  if (text[0] == '$') {
+    start++;
+    base = 16;
+  } else if (text.size() > 2 && text[0] == '0' &&
+             (text[1] == 'x' || text[1] == 'X')) {
+    start += 2;
+    base = 16;
+  }
+  char* end = nullptr;
+  unsigned long result = std::strtoul(start, &end, base);
+  if (end == start || *end != '\0') {
+    return false;
+  }
+  value = result;
+  return true;
+}
+
+// hex by default, io register names work too
+bool
+parseAddress(const std::string& text, uint16& addr)
+{
+  int32 io = Debugger::ioRegister(text);
+  if (io >= 0) {
+    addr = io;
+    return true;
+  }
+  uint32 value = 0;
+  if (!parseNumber(text, value, 16) || value > 0xFFFF) {
+    return false;
+  }
+  addr = value;
+  return true;
+}
+
+const uint64*
+everyAddress()
+{
+  static const std::vector<uint64> bitmap(0x10000 / 64, ~0ull);
+  return bitmap.data();
+}
+
+}
+
+Debugger::Debugger(CPU* cpu, MMU* mmu)
+  : m_cpu(cpu)
+  , m_mmu(mmu)
+{
+  m_cpu->setDebugger(this);
+  m_mmu->setDebugger(this);
+}
+
+Debugger::~Debugger()
+{
+  m_cpu->setDebugger(nullptr);
+  m_cpu->setBreakpoints(nullptr);
+  m_mmu->setDebugger(nullptr);
+  m_mmu->setWatchedPages(nullptr);
+}
+
+void
+Debugger::addBreakpoint(uint16 addr)
+{
+  uint64 bit = 1ull << (addr & 63);
+  if ((m_breakpoints[addr >> 6] & bit) == 0) {
+    m_breakpoints[addr >> 6] |= bit;
+    m_breakpoint_count++;
+  }
+  publish();
+}
+
+void
+Debugger::removeBreakpoint(uint16 addr)
+{
+  uint64 bit = 1ull << (addr & 63);
+  if ((m_breakpoints[addr >> 6] & bit) != 0) {
+    m_breakpoints[addr >> 6] &= ~bit;
+    m_breakpoint_count--;
+  }
+  publish();
+}
+
+void
+Debugger::addWatchpoint(uint16 start, uint16 end, uint8 access)
+{
+  if (end < start) {
+    std::swap(start, end);
+  }
+  m_watchpoints.push_back({ start, end, access });
+  publish();
+}
+
+void
+Debugger::removeWatchpoint(size_t index)
+{
+  if (index < m_watchpoints.size()) {
+    m_watchpoints.erase(m_watchpoints.begin() + index);
+  }
+  publish();
+}
+
+void
+Debugger::step(uint32 count)
+{
+  m_steps = std::max<uint32>(count, 1);
+  publish();
+}
+
+void
+Debugger::publish()
+{
+  if (m_steps > 0) {
+    m_cpu->setBreakpoints(everyAddress());
+  } else {
+    m_cpu->setBreakpoints(m_breakpoint_count > 0 ? m_breakpoints : nullptr);
+  }
+  std::fill(std::begin(m_watched_pages), std::end(m_watched_pages), 0);
+  for (const Watchpoint& watchpoint : m_watchpoints) {
+    for (uint32 page = watchpoint.start >> 8; page <= watchpoint.end >> 8;
+         page++) {
+      m_watched_pages[page] |= watchpoint.access;
+    }
+  }
+  m_mmu->setWatchedPages(m_watchpoints.empty() ? nullptr : m_watched_pages);
+}
+
+void
+Debugger::onInstruction(uint16 addr)
+{
+  bool stepped = false;
+  if (m_steps > 0) {
+    m_steps--;
+    stepped = m_steps == 0;
+  }
+  bool breakpoint = (m_breakpoints[addr >> 6] >> (addr & 63)) & 1;
+  if (!stepped && !breakpoint) {
+    return;
+  }
+  m_steps = 0;
+  if (breakpoint && m_hit.empty()) {
+    m_hit = format("Breakpoint at $%04X", addr);
+  }
+  console(addr);
+  publish();
+}
+
+void
+Debugger::onAccess(uint16 addr, uint8 val, Access access)
+{
+  if ((m_watched_pages[addr >> 8] & access) == 0) {
+    return;
+  }
+  for (const Watchpoint& watchpoint : m_watchpoints) {
+    if ((watchpoint.access & access) == 0 || addr < watchpoint.start ||
+        addr > watchpoint.end) {
+      continue;
+    }
+    const char* name = ioName(addr);
+    std::ostringstream hit;
+    hit << "Watchpoint: "
+        << (access == Access::Write ? format("write $%02X to", val)
+                                    : std::string("read from"))
+        << format(" $%04X", addr) << (name ? std::string(" ") + name : "");
+    m_hit = hit.str();
+    // the access is in the middle of an instruction, stop after it
+    if (m_steps == 0) {
+      step(1);
+    }
+    return;
+  }
+}
+
+int32
+Debugger::ioRegister(const std::string& name)
+{
+  std::string upper = name;
+  for (char& c : upper) {
+    c = std::toupper(static_cast<unsigned char>(c));
+  }
+  for (const auto& [io_name, addr] : IoRegisters) {
+    if (upper == io_name) {
+      return addr;
+    }
+  }
+  return -1;
+}
+
+uint8
+Debugger::peek(uint16 addr) const
+{
+  return m_mmu->read(addr, Component::Debug);
+}
+
+std::string
+Debugger::disassemble(uint16 addr, uint8* length) const
+{
+  uint8 opcode = peek(addr);
+  uint8 size = 1;
+  std::string text;
+  if (opcode == 0xCB) {
+    uint8 cb = peek(addr + 1);
+    const char* reg = Registers[cb & 0x07];
+    uint8 index = (cb >> 3) & 0x07;
+    switch (cb >> 6) {
+      case 0:
+        text = std::string(ShiftOps[index]) + " " + reg;
+        break;
+      case 1:
+        text = format("bit %u, ", index) + reg;
+        break;
+      case 2:
+        text = format("res %u, ", index) + reg;
+        break;
+      case 3:
+        text = format("set %u, ", index) + reg;
+        break;
+    }
+    size = 2;
+  } else if (opcode == 0x76) {
+    text = "halt";
+  } else if (opcode >= 0x40 && opcode < 0x80) {
+    text = std::string("ld ") + Registers[(opcode >> 3) & 0x07] + ", " +
+           Registers[opcode & 0x07];
+  } else if (opcode >= 0x80 && opcode < 0xC0) {
+    text =
+      std::string(AluOps[(opcode >> 3) & 0x07]) + " " + Registers[opcode & 7];
+  } else if (Opcodes[opcode] == nullptr) {
+    text = format("db $%02X", opcode);
+  } else {
+    text = Opcodes[opcode];
+    uint8 low = peek(addr + 1);
+    uint16 word = low | (peek(addr + 2) << 8);
+    std::string comment;
+    size_t pos;
+    if ((pos = text.find("n16")) != std::string::npos ||
+        (pos = text.find("a16")) != std::string::npos) {
+      text.replace(pos, 3, format("$%04X", word));
+      size = 3;
+    } else if ((pos = text.find("n8")) != std::string::npos) {
+      text.replace(pos, 2, format("$%02X", low));
+      size = 2;
+    } else if ((pos = text.find("a8")) != std::string::npos) {
+      text.replace(pos, 2, format("$%04X", 0xFF00 | low));
+      const char* name = ioName(0xFF00 | low);
+      if (name != nullptr) {
+        comment = std::string(" ; ") + name;
+      }
+      size = 2;
+    } else if ((pos = text.find("e8")) != std::string::npos) {
+      text.replace(pos, 2, format("$%04X", uint16(addr + 2 + int8(low))));
+      size = 2;
+    } else if ((pos = text.find("s8")) != std::string::npos) {
+      text.replace(pos, 2, format("%d", int32(int8(low))));
+      size = 2;
+    }
+    text += comment;
+  }
+  if (length != nullptr) {
+    *length = size;
+  }
+  return text;
+}
+
+void
+Debugger::console(uint16 pc)
+{
+  if (!m_hit.empty()) {
+    std::printf("%s\n", m_hit.c_str());
+    m_hit.clear();
+  }
+  std::printf("$%04X: %s\n", pc, disassemble(pc).c_str());
+  std::string line;
+  while (true) {
+    std::printf("(gbdb) ");
+    std::fflush(stdout);
+    if (!std::getline(std::cin, line)) {
+      // nobody is at the console anymore, stopping again would be useless
+      std::printf("\n");
+      log_info("Debugger console closed, removing all breakpoints");
+      std::fill(std::begin(m_breakpoints), std::end(m_breakpoints), 0);
+      m_breakpoint_count = 0;
+      m_watchpoints.clear();
+      m_steps = 0;
+      return;
+    }
+    if (line.empty()) {
+      line = m_last_command;
+    } else {
+      m_last_command = line;
+    }
+    if (!runCommand(line, pc)) {
+      return;
+    }
+  }
+}
+
+bool
+Debugger::runCommand(const std::string& line, uint16 pc)
+{
+  std::istringstream words(line);
+  std::string command;
+  std::vector<std::string> args;
+  words >> command;
+  for (std::string arg; words >> arg;) {
+    args.push_back(arg);
+  }
+  uint32 count = 0;
+  uint16 addr = 0;
+  if (command.empty()) {
+    return true;
+  } else if (command == "c" || command == "continue") {
+    return false;
+  } else if (command == "s" || command == "step") {
+    if (args.empty() || !parseNumber(args[0], count, 10)) {
+      count = 1;
+    }
+    step(count);
+    return false;
+  } else if (command == "r" || command == "regs") {
+    printRegisters(pc);
+  } else if (command == "x" || command == "mem") {
+    if (args.empty() || !parseAddress(args[0], addr)) {
+      std::printf("Usage: mem <addr> [length]\n");
+      return true;
+    }
+    if (args.size() < 2 || !parseNumber(args[1], count, 10)) {
+      count = 64;
+    }
+    printMemory(addr, count);
+  } else if (command == "d" || command == "dis") {
+    addr = pc;
+    if (!args.empty() && !parseAddress(args[0], addr)) {
+      std::printf("Usage: dis [addr] [count]\n");
+      return true;
+    }
+    if (args.size() < 2 || !parseNumber(args[1], count, 10)) {
+      count = 8;
+    }
+    for (uint32 i = 0; i < count; i++) {
+      uint8 length = 0;
+      std::string text = disassemble(addr, &length);
+      std::printf(
+        "%s$%04X: %s\n", addr == pc ? "> " : "  ", addr, text.c_str());
+      addr += length;
+    }
+  } else if (command == "b" || command == "break") {
+    if (args.empty() || !parseAddress(args[0], addr)) {
+      std::printf("Usage: break <addr>\n");
+      return true;
+    }
+    addBreakpoint(addr);
+  } else if (command == "delete") {
+    if (args.empty() || !parseAddress(args[0], addr)) {
+      std::printf("Usage: delete <addr>\n");
+      return true;
+    }
+    removeBreakpoint(addr);
+  } else if (command == "w" || command == "watch") {
+    uint8 access = 0;
+    uint16 end = 0;
+    if (args.size() == 2) {
+      access |= args[0].find('r') != std::string::npos ? Access::Read : 0;
+      access |= args[0].find('w') != std::string::npos ? Access::Write : 0;
+      size_t dash = args[1].find('-');
+      std::string last =
+        dash == std::string::npos ? args[1] : args[1].substr(dash + 1);
+      if (!parseAddress(args[1].substr(0, dash), addr) ||
+          !parseAddress(last, end)) {
+        access = 0;
+      }
+    }
+    if (access == 0) {
+      std::printf("Usage: watch <r|w|rw> <addr or io register>[-<end>]\n");
+      return true;
+    }
+    addWatchpoint(addr, end, access);
+  } else if (command == "unwatch") {
+    if (args.empty() || !parseNumber(args[0], count, 10) ||
+        count >= m_watchpoints.size()) {
+      std::printf("Usage: unwatch <index from list>\n");
+      return true;
+    }
+    removeWatchpoint(count);
+  } else if (command == "l" || command == "list") {
+    printBreakpoints();
+  } else if (command == "h" || command == "help") {
+    std::printf("c, continue             run until something breaks\n"
+                "s, step [n]             run n instructions\n"
+                "r, regs                 show the registers\n"
+                "x, mem <addr> [n]       dump n bytes of memory\n"
+                "d, dis [addr] [n]       disassemble n instructions\n"
+                "b, break <addr>         break before the instruction\n"
+                "delete <addr>           remove a breakpoint\n"
+                "w, watch <r|w|rw> <addr>[-<end>]\n"
+                "                        break on accesses, io register "
+                "names work too\n"
+                "unwatch <index>         remove a watchpoint\n"
+                "l, list                 show breakpoints and watchpoints\n"
+                "an empty line repeats the last command\n");
+  } else {
+    std::printf("Unknown command %s, try help\n", command.c_str());
+  }
+  return true;
+}
+
+void
+Debugger::printRegisters(uint16 pc) const
+{
+  const CPU& cpu = *m_cpu;
+  uint16 af = cpu.currentAF();
+  uint8 f = af & 0xFF;
+  std::printf("AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X PC=%04X\n",
+              af,
+              cpu.BC,
+              cpu.DE,
+              cpu.HL,
+              cpu.SP,
+              pc);
+  std::printf("flags=%c%c%c%c IME=%d IE=%02X IF=%02X%s\n",
+              (f & 0x80) ? 'Z' : '-',
+              (f & 0x40) ? 'N' : '-',
+              (f & 0x20) ? 'H' : '-',
+              (f & 0x10) ? 'C' : '-',
+              cpu.ime == CPU::Ime::Enable,
+              cpu.IER,
+              cpu.IFR,
+              cpu.halted ? " halted" : "");
+}
+
+void
+Debugger::printMemory(uint16 addr, uint32 length) const
+{
+  for (uint32 line = 0; line < length; line += 16) {
+    std::printf("$%04X:", uint16(addr + line));
+    for (uint32 i = line; i < std::min(length, line + 16); i++) {
+      std::printf(" %02X", peek(addr + i));
+    }
+    std::printf("\n");
+  }
+}
+
+void
+Debugger::printBreakpoints() const
+{
+  for (uint32 addr = 0; addr < 0x10000; addr++) {
+    if ((m_breakpoints[addr >> 6] >> (addr & 63)) & 1) {
+      std::printf("break $%04X\n", addr);
+    }
+  }
+  for (size_t i = 0; i < m_watchpoints.size(); i++) {
+    const Watchpoint& watchpoint = m_watchpoints[i];
+    std::printf("watch %zu: %s%s $%04X-$%04X\n",
+                i,
+                (watchpoint.access & Access::Read) ? "r" : "",
+                (watchpoint.access & Access::Write) ? "w" : "",
+                watchpoint.start,
+                watchpoint.end);
+  }
+}
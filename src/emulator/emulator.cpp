@@ -1,7 +1,9 @@
 #include "emulator.h"
 
 #include <SDL2/SDL.h>
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <thread>
 
 #include "common.h"
@@ -19,17 +21,30 @@ Emulator::Emulator(std::string file)
   m_timer = std::make_unique<Timer>();
   m_apu = std::make_unique<APU>();
   m_joypad = std::make_unique<Joypad>();
+  m_serial = std::make_unique<Serial>();
   m_mmu = std::make_unique<MMU>(m_cpu.get(),
                                 m_cartridge.get(),
                                 m_ppu.get(),
                                 m_timer.get(),
                                 m_apu.get(),
-                                m_joypad.get());
+                                m_joypad.get(),
+                                m_serial.get());
   m_cpu->setMMU(m_mmu.get());
   m_ppu->setMMU(m_mmu.get());
   m_timer->setMMU(m_mmu.get());
+  m_timer->setAPU(m_apu.get());
+  m_timer->setClock(&m_Tcycles);
+  m_apu->setClock(&m_Tcycles);
   m_joypad->setMMU(m_mmu.get());
+  m_serial->setMMU(m_mmu.get());
+  m_serial->setTimer(m_timer.get());
+  m_serial->setClock(&m_Tcycles);
+  m_serial->setSinks(&m_serial_sinks);
   m_Tcycles = 0;
+  if (m_cartridge->isValidCartridge()) {
+    finishBootVBlank();
+  }
+  m_frame_end = m_Tcycles + TicksPerFrame;
 }
 
 Emulator::~Emulator()
@@ -45,32 +60,326 @@ Emulator::isValid()
   return m_cartridge->isValidCartridge();
 }
 
+void
+Emulator::saveSnapshot(EmulatorSnapshot& snapshot) const
+{
+  snapshot.cpu = *m_cpu;
+  snapshot.ppu = *m_ppu;
+  snapshot.timer = *m_timer;
+  snapshot.apu = *m_apu;
+  snapshot.joypad = *m_joypad;
+  snapshot.serial = *m_serial;
+  snapshot.mmu = *m_mmu;
+  m_cartridge->saveState(snapshot.mbc);
+  snapshot.Tcycles = m_Tcycles;
+  snapshot.frame_end = m_frame_end;
+}
+
+void
+Emulator::loadSnapshot(const EmulatorSnapshot& snapshot)
+{
+  *m_cpu = snapshot.cpu;
+  *m_ppu = snapshot.ppu;
+  *m_timer = snapshot.timer;
+  *m_apu = snapshot.apu;
+  *m_joypad = snapshot.joypad;
+  *m_serial = snapshot.serial;
+  *m_mmu = snapshot.mmu;
+  m_cartridge->loadState(snapshot.mbc);
+  m_Tcycles = snapshot.Tcycles;
+  m_frame_end = snapshot.frame_end;
+  m_framebuffer_ticks = UINT64_MAX;
+  // copies carry the mmu of the emulator the snapshot was taken from
+  m_ppu->setMMU(m_mmu.get());
+  m_timer->setMMU(m_mmu.get());
+  m_timer->setAPU(m_apu.get());
+  m_timer->setClock(&m_Tcycles);
+  m_joypad->setMMU(m_mmu.get());
+  m_serial->setMMU(m_mmu.get());
+  m_serial->setTimer(m_timer.get());
+  m_serial->setClock(&m_Tcycles);
+  m_serial->setSinks(&m_serial_sinks);
+  m_serial->setLink(m_link);
+  m_apu->setClock(&m_Tcycles);
+  m_apu->setOutput(m_audio.get());
+}
+
+void
+Emulator::setPressedButtons(uint8 pressed)
+{
+  m_joypad->setPressedButtons(pressed);
+}
+
+AudioOutput*
+Emulator::enableAudioOutput(uint32 sample_rate)
+{
+  m_audio = std::make_unique<AudioOutput>(sample_rate);
+  m_apu->setOutput(m_audio.get());
+  return m_audio.get();
+}
+
+void
+Emulator::audioCallback(void* userdata, Uint8* stream, int len)
+{
+  Emulator* emulator = static_cast<Emulator*>(userdata);
+  int16* frames = reinterpret_cast<int16*>(stream);
+  uint32 count = len / (2 * sizeof(int16));
+  uint32 popped = 0;
+  if (emulator->m_audio) {
+    popped = emulator->m_audio->getRing().pop(frames, count);
+  }
+  // on underrun play silence instead of stale data
+  std::memset(frames + popped * 2, 0, (count - popped) * 2 * sizeof(int16));
+}
+
+bool
+Emulator::recordAudio(const std::string& path, uint32 sample_rate)
+{
+  m_audio_writer = std::make_unique<AudioFileWriter>(path, sample_rate);
+  if (!m_audio_writer->isOpen()) {
+    m_audio_writer.reset();
+    return false;
+  }
+  enableAudioOutput(sample_rate);
+  return true;
+}
+
+Debugger*
+Emulator::enableDebugger()
+{
+  if (!m_debugger) {
+    m_debugger = std::make_unique<Debugger>(m_cpu.get(), m_mmu.get());
+  }
+  return m_debugger.get();
+}
+
+bool
+Emulator::recordVideo(const std::string& path)
+{
+  m_video = std::make_unique<VideoRecorder>(path, m_palette);
+  if (!m_video->isOpen()) {
+    m_video.reset();
+    return false;
+  }
+  return true;
+}
+
+bool
+Emulator::recordTrace(const std::string& path)
+{
+  m_cpu->setTracer(nullptr);
+  m_trace = std::make_unique<TraceRecorder>(path);
+  if (!m_trace->isOpen()) {
+    m_trace.reset();
+    return false;
+  }
+  m_trace->setClock(&m_Tcycles);
+  m_cpu->setTracer(m_trace.get());
+  return true;
+}
+
+uint64
+Emulator::droppedVideoFrames() const
+{
+  return m_video ? m_video->framesDropped() : 0;
+}
+
+bool
+Emulator::syncToAudio()
+{
+  // ring level that is left when the next frame starts emulating, together
+  // with one frame and the device buffer it keeps latency under 40ms
+  constexpr uint32 TargetLatencyMs = 10;
+  constexpr double MaxRateDelta = 0.005;
+  if (!m_audio) {
+    return false;
+  }
+  AudioRing& ring = m_audio->getRing();
+  const uint32 target = m_audio->getSampleRate() * TargetLatencyMs / 1000;
+  const double frame_samples =
+    m_audio->getSampleRate() * double(TicksPerFrame) / GB_CLOCK_RATE;
+
+  // steer towards the level expected right after a frame was pushed, a
+  // fuller ring gets slightly fewer samples per frame and an emptier one more
+  double expected = target + frame_samples;
+  double error = (expected - ring.size()) / expected;
+  error = std::max(-1.0, std::min(1.0, error));
+  m_audio->setRateAdjust(1.0 + MaxRateDelta * error);
+
+  // a device that stopped draining the ring (paused, unplugged or a stalled
+  // callback) must not block the main loop, the frame is paced by time then
+  const auto frame_time = std::chrono::duration<double>(
+    double(TicksPerFrame) / GB_CLOCK_RATE);
+  const auto deadline =
+    std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      2 * frame_time);
+  while (ring.size() > target) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(250));
+  }
+  return true;
+}
+
+uint8
+Emulator::peek(uint16 addr)
+{
+  return m_mmu->read(addr, Component::Debug);
+}
+
+void
+Emulator::tick()
+{
+  m_cpu->tick(m_Tcycles);
+  if (m_Tcycles >= m_timer->nextEvent()) {
+    m_timer->catchUp(m_Tcycles + 1);
+  }
+  if (m_Tcycles >= m_serial->nextEvent()) {
+    m_serial->catchUp(m_Tcycles + 1);
+  }
+  m_ppu->tick(m_Tcycles);
+  m_ppu->tick_dma(m_Tcycles);
+  m_Tcycles++;
+}
+
+uint64
+Emulator::ticksToNextEvent(uint64 limit)
+{
+  uint64 ticks = std::min<uint64>(limit - m_Tcycles, m_ppu->idleTicks());
+  for (uint64 event : { m_timer->nextEvent(), m_serial->nextEvent() }) {
+    if (event <= m_Tcycles) {
+      return 0;
+    }
+    ticks = std::min(ticks, event - m_Tcycles);
+  }
+  return ticks;
+}
+
+bool
+Emulator::skipHaltedTicks(uint64 limit)
+{
+  // With the cpu halted nothing happens until the next timer or serial
+  // event or PPU mode/LY change except the PPU counting through a blanking
+  // period
+  uint64 ticks = ticksToNextEvent(limit);
+  if (ticks == 0) {
+    return false;
+  }
+  m_ppu->skipIdleTicks(ticks);
+  m_Tcycles += ticks;
+  return true;
+}
+
+void
+Emulator::setIdleLoopDetection(bool enabled)
+{
+  m_cpu->setIdleLoopDetection(enabled);
+}
+
+void
+Emulator::setBlockCaching(bool enabled)
+{
+  m_cpu->setBlockCaching(enabled);
+}
+
+void
+Emulator::setFlagVerification(bool enabled)
+{
+  m_cpu->setFlagVerification(enabled);
+}
+
+void
+Emulator::setFastOamDma(bool enabled)
+{
+  m_ppu->setFastDma(enabled);
+}
+
+void
+Emulator::setSavesEnabled(bool enabled)
+{
+  if (isValid()) {
+    m_cartridge->setSavesEnabled(enabled);
+  }
+}
+
+void
+Emulator::skipIdleLoop(uint64 limit)
+{
+  // Whole iterations can be skipped as long as everything the loop polls
+  // stays the same, which holds until the same events that end a halt
+  const IdleLoopInfo& loop = m_cpu->getIdleLoop();
+  uint64 ticks = ticksToNextEvent(limit);
+  for (uint8 i = 0; i < loop.reads; i++) {
+    if (peek(loop.addr[i]) != loop.value[i]) {
+      return;
+    }
+    if (loop.addr[i] == 0xFF04) {
+      ticks = std::min(ticks, m_timer->nextDivChange() - m_Tcycles);
+    }
+  }
+  uint64 period = loop.cycles * 4;
+  ticks -= ticks % period;
+  if (ticks == 0) {
+    return;
+  }
+  m_ppu->skipIdleTicks(ticks);
+  m_Tcycles += ticks;
+}
+
+void
+Emulator::finishBootVBlank()
+{
+  // The PPU is handed over at the end of the last VBlank line which is
+  // at most 456 - 395 ticks away, running it out here means every
+  // cycleFrame starts on the first line
+  while (m_ppu->getMode() == PpuMode::VBlank) {
+    tick();
+  }
+  log_debug("It took %ld ticks to get out of vblanks", m_Tcycles);
+}
+
 void
 Emulator::cycleFrame()
 {
-  constexpr uint64 TicksPerFrame = 70224;
-  if (m_Tcycles == 0) {
-    while (m_ppu->getMode() == PpuMode::VBlank) {
-      m_cpu->tick(m_Tcycles);
-      if ((m_Tcycles % 4) == 3) {
-        m_timer->M_tick();
+  runFor(m_frame_end - m_Tcycles);
+}
+
+void
+Emulator::runFor(uint64 ticks)
+{
+  const uint64 end = m_Tcycles + ticks;
+  while (m_Tcycles < end) {
+    const uint64 limit = std::min(end, m_frame_end);
+    while (m_Tcycles < limit) {
+      if (m_cpu->isHalted() && skipHaltedTicks(limit)) {
+        continue;
+      }
+      tick();
+      if (m_cpu->hasIdleLoop()) {
+        skipIdleLoop(limit);
       }
-      m_ppu->tick_dma(m_Tcycles);
-      m_ppu->tick(m_Tcycles);
-      m_apu->tick();
-      m_Tcycles++;
     }
-    log_info("It took %ld ticks to get out of vblanks", m_Tcycles);
-  }
-  for (uint64 i = 0; i < TicksPerFrame; i++) {
-    m_cpu->tick(m_Tcycles);
-    if ((m_Tcycles % 4) == 3) {
-      m_timer->M_tick();
+    if (m_Tcycles == m_frame_end) {
+      finishFrame();
     }
-    m_ppu->tick(m_Tcycles);
-    m_ppu->tick_dma(m_Tcycles);
-    m_apu->tick();
-    m_Tcycles++;
+  }
+}
+
+void
+Emulator::finishFrame()
+{
+  m_apu->endFrame();
+  if (m_video) {
+    m_video->pushFrame(m_ppu->LCD_SHADES);
+  }
+  m_frame_end += TicksPerFrame;
+  // in case the game never disables cartridge ram after writing a save
+  constexpr uint64 FramesPerSaveFlush = 300;
+  m_frames++;
+  if ((m_frames % FramesPerSaveFlush) == 0) {
+    m_cartridge->flushSave();
   }
 }
 
@@ -103,6 +412,11 @@ Emulator::HandleSdlEvent(SDL_Event& event)
       break;
     case SDL_KEYDOWN:
       switch (event.key.keysym.sym) {
+        case SDLK_F1:
+          if (m_debugger) {
+            m_debugger->requestBreak();
+          }
+          break;
         case SDLK_w:
         case SDLK_a:
         case SDLK_s:
@@ -136,7 +450,24 @@ Emulator::mainLoop()
   constexpr int SCREEN_WIDTH = SCALE * GB_WIDTH;
   constexpr int SCREEN_HEIGHT = SCALE * GB_HEIGHT;
 
-  SDL_Init(SDL_INIT_VIDEO);
+  SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+  SDL_AudioSpec wanted_spec;
+  SDL_AudioSpec audio_spec;
+  SDL_zero(wanted_spec);
+  wanted_spec.freq = 48000;
+  wanted_spec.format = AUDIO_S16SYS;
+  wanted_spec.channels = 2;
+  wanted_spec.samples = m_audio_sync ? 256 : 512;
+  wanted_spec.callback = audioCallback;
+  wanted_spec.userdata = this;
+  SDL_AudioDeviceID audio_device = SDL_OpenAudioDevice(
+    nullptr, 0, &wanted_spec, &audio_spec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+  if (audio_device == 0) {
+    log_error("Failed to open audio device: %s", SDL_GetError());
+  } else {
+    enableAudioOutput(audio_spec.freq);
+    SDL_PauseAudioDevice(audio_device, 0);
+  }
   SDL_CreateWindowAndRenderer(
     SCREEN_WIDTH, SCREEN_HEIGHT, 0, &sdlWindow, &sdlRenderer);
   screen = SDL_CreateRGBSurface(0,
@@ -168,8 +499,13 @@ Emulator::mainLoop()
       }
     }
 
+    uint8 pressed = m_joypad->getPressedButtons();
     cycleFrame();
+    if (m_movie) {
+      m_movie->addFrame(pressed, frameHash());
+    }
 
+    const uint32* pixels = getFramebuffer();
     SDL_Rect rc;
     rc.x = rc.y = 0;
     rc.w = SCREEN_WIDTH;
@@ -182,7 +518,7 @@ Emulator::mainLoop()
         rc.w = SCALE;
         rc.h = SCALE;
 
-        uint32 c = m_ppu->LCD_PIXELS[(line_num * GB_WIDTH) + x];
+        uint32 c = pixels[(line_num * GB_WIDTH) + x];
         SDL_FillRect(screen, &rc, c);
       }
     }
@@ -195,12 +531,27 @@ Emulator::mainLoop()
     auto frameEnd = std::chrono::steady_clock::now();
     delta = frameEnd - frameStart;
 
+    if (m_audio_sync) {
+      if (syncToAudio()) {
+        continue;
+      }
+      // the time spent waiting on the device counts towards the frame
+      delta = std::chrono::steady_clock::now() - frameStart;
+    }
     if (delta.count() < FPSMAX) {
       std::this_thread::sleep_for(std::chrono::nanoseconds(
         static_cast<int64>((FPSMAX - delta.count()) * 1000000)));
     }
   }
 
+  if (audio_device != 0) {
+    SDL_CloseAudioDevice(audio_device);
+  }
+  if (m_movie && m_movie->save(m_movie_path)) {
+    log_info("Saved %lu frames of input to %s",
+             m_movie->frames(),
+             m_movie_path.c_str());
+  }
   SDL_DestroyTexture(sdlTexture);
   SDL_FreeSurface(screen);
   SDL_DestroyRenderer(sdlRenderer);
@@ -208,6 +559,142 @@ Emulator::mainLoop()
   SDL_Quit();
 }
 
+const uint32*
+Emulator::getFramebuffer()
+{
+  if (m_framebuffer_ticks != m_Tcycles) {
+    shadesToArgb(
+      m_ppu->LCD_SHADES, m_framebuffer, GB_HEIGHT * GB_WIDTH, m_palette);
+    m_framebuffer_ticks = m_Tcycles;
+  }
+  return m_framebuffer;
+}
+
+void
+Emulator::setPalette(const Palette& palette)
+{
+  m_palette = palette;
+  m_framebuffer_ticks = UINT64_MAX;
+}
+
+uint64
+Emulator::frameHash() const
+{
+  return m_ppu->getFrameHash();
+}
+
+void
+Emulator::recordMovie(const std::string& path)
+{
+  m_movie = std::make_unique<Movie>(m_cartridge->getRomHash());
+  m_movie_path = path;
+  MBC_State state;
+  m_cartridge->saveState(state);
+  m_movie->setStartRam(state.ram);
+}
+
+bool
+Emulator::replayMovie(const Movie& movie)
+{
+  if (movie.romHash() != m_cartridge->getRomHash()) {
+    log_error("The movie was recorded with a different rom");
+    return false;
+  }
+  // the replay starts from the ram of the recording and must not end up
+  // in the save file of the player
+  m_cartridge->setSavesEnabled(false);
+  MBC_State state;
+  m_cartridge->saveState(state);
+  if (movie.startRam().size() != state.ram.size()) {
+    log_error("The movie doesn't match the cartridge ram size");
+    return false;
+  }
+  state.ram = movie.startRam();
+  m_cartridge->loadState(state);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64 frame = 0; frame < movie.frames(); frame++) {
+    m_joypad->setPressedButtons(movie.buttons(frame));
+    cycleFrame();
+    if (frameHash() != movie.frameHash(frame)) {
+      log_error("Replay diverged from the recording on frame %lu", frame);
+      return false;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  log_info("Replayed %lu frames in %.2fs, %.0f fps",
+           movie.frames(),
+           elapsed.count(),
+           movie.frames() / std::max(elapsed.count(), 1e-9));
+  return true;
+}
+
+TestResult
+Emulator::runHeadless(uint64 frames, bool stop_on_result)
+{
+  std::vector<int16> samples;
+  if (m_audio_writer) {
+    samples.resize(m_audio->getRing().capacity() * 2);
+  }
+  SerialBufferSink serial_output;
+  if (stop_on_result) {
+    addSerialSink(&serial_output);
+  }
+  TestResult result = TestResult::None;
+  for (uint64 frame = 0; frame < frames; frame++) {
+    cycleFrame();
+    if (m_audio_writer) {
+      uint32 count = m_audio->getRing().pop(samples.data(), samples.size() / 2);
+      m_audio_writer->write(samples.data(), count);
+    }
+    if (stop_on_result) {
+      result = parseTestResult(serial_output.getOutput());
+      if (result != TestResult::None) {
+        log_info("Test rom reported a result after %lu frames", frame + 1);
+        break;
+      }
+    }
+  }
+  removeSerialSink(&serial_output);
+  return result;
+}
+
+TestResult
+Emulator::parseTestResult(const std::string& output)
+{
+  // blargg's roms end with either of these, the failing ones followed by
+  // the number of the failed test
+  if (output.find("Passed") != std::string::npos) {
+    return TestResult::Passed;
+  }
+  if (output.find("Failed") != std::string::npos) {
+    return TestResult::Failed;
+  }
+  return TestResult::None;
+}
+
+void
+Emulator::addSerialSink(SerialSink* sink)
+{
+  m_serial_sinks.push_back(sink);
+}
+
+void
+Emulator::connectLink(LinkPort* port)
+{
+  m_link = port;
+  m_serial->setLink(port);
+}
+
+void
+Emulator::removeSerialSink(SerialSink* sink)
+{
+  m_serial_sinks.erase(
+    std::remove(m_serial_sinks.begin(), m_serial_sinks.end(), sink),
+    m_serial_sinks.end());
+}
+
 void
 Emulator::run()
 {
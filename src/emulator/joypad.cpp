@@ -26,6 +26,18 @@ Joypad::handleButton(JoypadInputs button, bool released)
   }
 }
 
+void
+Joypad::setPressedButtons(uint8 pressed)
+{
+  uint8 changed = static_cast<uint8>(~buttons) ^ pressed;
+  for (uint8 bit = 0; bit < 8; bit++) {
+    uint8 button = 1 << bit;
+    if ((changed & button) != 0) {
+      handleButton(static_cast<JoypadInputs>(button), (pressed & button) == 0);
+    }
+  }
+}
+
 void
 Joypad::write(uint8 val)
 {
@@ -0,0 +1,172 @@
+#include "link.h"
+#include "emulator.h"
+#include "serial.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+uint32
+channelCapacity(uint32 quantum)
+{
+  // a channel holds at most two quanta of messages, each with a state and
+  // a transfer every 4096 T-cycles at the most
+  return 2 * (quantum / 4096 + 2);
+}
+
+}
+
+LinkChannel::LinkChannel(uint32 capacity)
+{
+  m_buffer.resize(roundUpPowerOfTwo(capacity));
+  m_mask = m_buffer.size() - 1;
+}
+
+bool
+LinkChannel::push(const LinkMessage& message)
+{
+  uint32 write = m_write.load(std::memory_order_relaxed);
+  uint32 read = m_read.load(std::memory_order_acquire);
+  if (write - read > m_mask) {
+    return false;
+  }
+  m_buffer[write & m_mask] = message;
+  m_write.store(write + 1, std::memory_order_release);
+  return true;
+}
+
+bool
+LinkChannel::peek(LinkMessage& message) const
+{
+  uint32 read = m_read.load(std::memory_order_relaxed);
+  if (read == m_write.load(std::memory_order_acquire)) {
+    return false;
+  }
+  message = m_buffer[read & m_mask];
+  return true;
+}
+
+void
+LinkChannel::pop()
+{
+  m_read.store(m_read.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+}
+
+void
+LinkPort::connect(LinkChannel* incoming, LinkChannel* outgoing)
+{
+  m_incoming = incoming;
+  m_outgoing = outgoing;
+  m_quantum = 0;
+  m_state_changed = true;
+  m_peer_sb = 0xFF;
+  m_peer_sc = 0x7E;
+}
+
+void
+LinkPort::publish(uint8 sb, uint8 sc)
+{
+  m_state_changed |= sb != m_sb || sc != m_sc;
+  m_sb = sb;
+  m_sc = sc;
+}
+
+uint8
+LinkPort::exchange(uint8 data)
+{
+  if (m_outgoing != nullptr &&
+      !m_outgoing->push({ m_quantum, LinkMessage::Type::Transfer, data, 0 })) {
+    log_error("Link channel is full, dropping a transfer");
+  }
+  if ((m_peer_sc & 0x81) != 0x80) {
+    return 0xFF;
+  }
+  // the other side is done with this byte until it starts waiting again
+  m_peer_sc &= 0x7F;
+  return m_peer_sb;
+}
+
+void
+LinkPort::deliver(uint64 quantum)
+{
+  m_quantum = quantum;
+  LinkMessage message;
+  // the other side may already be running this quantum, whatever it sent
+  // during it has to wait for the next one
+  while (m_incoming->peek(message) && message.quantum < quantum) {
+    m_incoming->pop();
+    if (message.type == LinkMessage::Type::State) {
+      m_peer_sb = message.data;
+      m_peer_sc = message.control;
+    } else if (m_serial != nullptr) {
+      m_serial->receive(message.data);
+    }
+  }
+}
+
+void
+LinkPort::endQuantum()
+{
+  if (!m_state_changed) {
+    return;
+  }
+  if (!m_outgoing->push(
+        { m_quantum, LinkMessage::Type::State, m_sb, m_sc })) {
+    log_error("Link channel is full, dropping a state update");
+    return;
+  }
+  m_state_changed = false;
+}
+
+LinkCable::LinkCable(Emulator& first, Emulator& second, uint32 quantum)
+  : m_emulators{ &first, &second }
+  , m_quantum_ticks(std::max<uint32>(quantum, 4))
+  , m_channels{ LinkChannel(channelCapacity(m_quantum_ticks)),
+                LinkChannel(channelCapacity(m_quantum_ticks)) }
+{
+  for (int side = 0; side < 2; side++) {
+    m_ports[side].connect(&m_channels[side], &m_channels[1 - side]);
+    m_emulators[side]->connectLink(&m_ports[side]);
+  }
+}
+
+LinkCable::~LinkCable()
+{
+  for (Emulator* emulator : m_emulators) {
+    emulator->connectLink(nullptr);
+  }
+}
+
+void
+LinkCable::run(uint64 frames)
+{
+  uint64 ticks = frames * Emulator::TicksPerFrame;
+  for (Progress& progress : m_done) {
+    progress.quanta.store(0, std::memory_order_relaxed);
+  }
+  std::thread second(&LinkCable::runSide, this, 1, ticks);
+  runSide(0, ticks);
+  second.join();
+}
+
+void
+LinkCable::runSide(int side, uint64 ticks)
+{
+  Emulator* emulator = m_emulators[side];
+  LinkPort& port = m_ports[side];
+  std::atomic<uint64>& done = m_done[side].quanta;
+  const std::atomic<uint64>& other = m_done[1 - side].quanta;
+  for (uint64 quantum = 0; ticks > 0; quantum++) {
+    port.deliver(port.m_quantum + 1);
+    uint64 run = std::min<uint64>(ticks, m_quantum_ticks);
+    emulator->runFor(run);
+    ticks -= run;
+    port.endQuantum();
+    done.store(quantum + 1, std::memory_order_release);
+    while (other.load(std::memory_order_acquire) < quantum + 1) {
+      std::this_thread::yield();
+    }
+  }
+}
@@ -1,29 +1,33 @@
 #include "mbc_controller.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <unistd.h>
 
 std::unique_ptr<MBC_Handler>
 MBC_Handler::CreateHandler(Cartridge* cartridge)
 {
-  uint8* data = cartridge->m_data.get();
-  header* cartridge_header = cartridge->m_cartridge_header;
+  const RomImage* rom = cartridge->m_rom.get();
+  const header* cartridge_header = cartridge->m_cartridge_header;
   std::unique_ptr<MBC_Handler> handler = nullptr;
   switch (cartridge_header->type) {
     case NoMBC:
-      handler = std::make_unique<NoMBC_Handler>(data, cartridge_header);
+      handler = std::make_unique<NoMBC_Handler>(rom);
       log_info("Created a NoMbc handler");
       break;
     case MBC1:
     case MBC1Ram:
     case MBC1RamB:
-      handler = std::make_unique<MBC1_Handler>(data, cartridge_header);
+      handler = std::make_unique<MBC1_Handler>(rom);
       log_info("Created an MBC1 handler");
       break;
     case MBC2:
     case MBC2B:
-      handler = std::make_unique<MBC2_Handler>(data, cartridge_header);
+      handler = std::make_unique<MBC2_Handler>(rom);
       log_info("Created an MBC2 handler");
       break;
     default:
@@ -34,60 +38,215 @@ MBC_Handler::CreateHandler(Cartridge* cartridge)
   return handler;
 }
 
-MBC_Handler::MBC_Handler(uint8* data, header* header)
-  : m_data(data)
-  , m_header(header)
+std::string MBC_Handler::save_directory = ".";
+
+void
+MBC_Handler::setSaveDirectory(const std::string& directory)
+{
+  save_directory = directory;
+}
+
+MBC_Handler::MBC_Handler(const RomImage* rom)
+  : m_data(rom->data())
+  , m_header(rom->getHeader())
+  , m_rom_hash(rom->hash())
 {
   m_has_battery = HAS_BATTERY.find(m_header->type) != HAS_BATTERY.cend();
+  m_saves_enabled = !save_directory.empty();
   m_rom_size = (32 * 1024) << m_header->rom_size;
   if (m_header->ram_size > 0) {
-    m_ram_size = RAM_SIZES.find(m_header->ram_size)->second;
-    m_ram = std::make_unique<uint8[]>(m_ram_size);
+    initializeRam(RAM_SIZES.find(m_header->ram_size)->second);
   }
-  if (m_has_battery && m_ram) {
+}
+
+MBC_Handler::~MBC_Handler()
+{
+  flush();
+  if (m_save_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(m_save_lock);
+      m_stop_saving = true;
+    }
+    // the thread writes a pending save before it stops
+    m_save_cv.notify_one();
+    m_save_thread.join();
+  }
+}
+
+void
+MBC_Handler::initializeRam(uint32 size)
+{
+  m_ram_size = size;
+  m_ram = std::make_unique<uint8[]>(m_ram_size);
+  if (m_has_battery && m_saves_enabled) {
+    // without a save file the game starts from cleared ram as well
+    m_saved_ram.assign(m_ram.get(), m_ram.get() + m_ram_size);
     load();
   }
 }
 
-MBC_Handler::~MBC_Handler()
+void
+MBC_Handler::setRamEnabled(bool enabled)
 {
-  if (m_has_battery && m_ram) {
-    save();
+  // games disable ram once they are done writing to it
+  if (m_enabled_ram && !enabled) {
+    flush();
   }
+  m_enabled_ram = enabled;
 }
 
 void
-MBC_Handler::save()
+MBC_Handler::flush()
 {
-  std::string name(m_header->title);
-  name = name + ".gbsave";
-  std::ofstream file(name, std::ios::binary);
-  log_info("Creating %s as a save file", name.c_str());
-  if (!file.is_open()) {
-    log_error("Failed to open %s can't save", name.c_str());
+  if (m_save_failed.exchange(false)) {
+    // the file still has older contents, retried with this flush
+    m_saved_ram.clear();
+    m_ram_dirty = true;
+  }
+  if (!m_saves_enabled || !m_has_battery || !m_ram || !m_ram_dirty) {
     return;
   }
-  for (uint32 i = 0; i < m_ram_size; i++) {
-    file << m_ram[i];
+  m_ram_dirty = false;
+  if (std::equal(m_ram.get(),
+                 m_ram.get() + m_ram_size,
+                 m_saved_ram.begin(),
+                 m_saved_ram.end())) {
+    return;
+  }
+  m_saved_ram.assign(m_ram.get(), m_ram.get() + m_ram_size);
+  {
+    std::lock_guard<std::mutex> guard(m_save_lock);
+    m_pending_save = m_saved_ram;
+    m_save_pending = true;
+  }
+  if (!m_save_thread.joinable()) {
+    m_save_thread = std::thread(&MBC_Handler::saveLoop, this);
+  }
+  m_save_cv.notify_one();
+}
+
+void
+MBC_Handler::saveLoop()
+{
+  std::vector<uint8> ram;
+  std::unique_lock<std::mutex> lock(m_save_lock);
+  while (true) {
+    m_save_cv.wait(lock, [this] { return m_save_pending || m_stop_saving; });
+    if (!m_save_pending) {
+      return;
+    }
+    // only the latest ram is written if flushes come in faster
+    ram.swap(m_pending_save);
+    m_save_pending = false;
+    lock.unlock();
+    if (!save(ram)) {
+      m_save_failed = true;
+    }
+    lock.lock();
+  }
+}
+
+std::string
+MBC_Handler::getSavePath() const
+{
+  // the rom hash keeps roms with the same title from sharing a save
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llX", (unsigned long long)m_rom_hash);
+  return save_directory + "/" + m_header->title + "-" + hash + ".gbsave";
+}
+
+bool
+MBC_Handler::save(const std::vector<uint8>& ram)
+{
+  std::string name = getSavePath();
+  // written to a temporary file and renamed over the old save so a crash
+  // never leaves a partially written save behind
+  std::string tmp_name = name + ".tmp" + std::to_string(getpid()) + "_" +
+                         std::to_string(reinterpret_cast<uintptr_t>(this));
+  log_info("Saving to %s", name.c_str());
+  int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    log_error("Failed to open %s can't save", tmp_name.c_str());
+    return false;
+  }
+  uint32 written = 0;
+  while (written < ram.size()) {
+    ssize_t ret = ::write(fd, ram.data() + written, ram.size() - written);
+    if (ret <= 0) {
+      break;
+    }
+    written += ret;
+  }
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  if (written != ram.size() || !synced ||
+      std::rename(tmp_name.c_str(), name.c_str()) != 0) {
+    log_error("Failed to write %s can't save", name.c_str());
+    std::remove(tmp_name.c_str());
+    return false;
+  }
+  // the rename only survives a crash once the directory is synced too
+  int dir_fd = open(save_directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
   }
   log_info("Done saving");
+  return true;
 }
 
 void
 MBC_Handler::load()
 {
-  std::string name(m_header->title);
-  name = name + ".gbsave";
+  std::string name = getSavePath();
   std::ifstream file(name, std::ios::binary);
   log_info("Attempting to load from %s save file", name.c_str());
   if (!file.is_open()) {
-    log_info("Failed to find or load save");
-    return;
+    // saves used to be named only by title in the working directory
+    std::string legacy_name = std::string(m_header->title) + ".gbsave";
+    file.open(legacy_name, std::ios::binary);
+    if (!file.is_open()) {
+      log_info("Failed to find or load save");
+      return;
+    }
+    log_info("Importing save from %s", legacy_name.c_str());
+    m_ram_dirty = true;
   }
   file.read((char*)m_ram.get(), m_ram_size);
+  if (m_ram_dirty) {
+    // the new save file doesn't exist yet
+    m_saved_ram.clear();
+  } else {
+    m_saved_ram.assign(m_ram.get(), m_ram.get() + m_ram_size);
+  }
   log_info("Done loading");
 }
 
+void
+MBC_Handler::saveState(MBC_State& state) const
+{
+  state.ram.assign(m_ram.get(), m_ram.get() + m_ram_size);
+  state.enabled_ram = m_enabled_ram;
+}
+
+void
+MBC_Handler::loadState(const MBC_State& state)
+{
+  if (state.ram.size() != m_ram_size) {
+    log_error("Save state ram size 0x%zX doesn't match cartridge ram size 0x%X",
+              state.ram.size(),
+              m_ram_size);
+    return;
+  }
+  std::copy(state.ram.begin(), state.ram.end(), m_ram.get());
+  m_enabled_ram = state.enabled_ram;
+  // only a state that differs from the save file has to be written
+  m_ram_dirty = !std::equal(m_ram.get(),
+                            m_ram.get() + m_ram_size,
+                            m_saved_ram.begin(),
+                            m_saved_ram.end());
+}
+
 void
 MBC_Handler::write(uint16 address, uint8 val)
 {
@@ -111,6 +270,12 @@ MBC_Handler::read(uint16 address)
   return 0xFF;
 }
 
+uint16
+MBC_Handler::romBank(uint16 address) const
+{
+  return address >= 0x4000 ? 1 : 0;
+}
+
 void
 NoMBC_Handler::write_rom(uint16 address, uint8 val)
 {
@@ -126,6 +291,7 @@ NoMBC_Handler::write_ram(uint16 address, uint8 val)
     return;
   }
   m_ram[address] = val;
+  m_ram_dirty = true;
 }
 
 uint8
@@ -144,39 +310,49 @@ NoMBC_Handler::read_ram(uint16 address)
   return m_ram[address];
 }
 
-MBC1_Handler::MBC1_Handler(uint8* data, header* header)
-  : MBC_Handler(data, header)
+MBC1_Handler::MBC1_Handler(const RomImage* rom)
+  : MBC_Handler(rom)
+  , m_is_mbc1m(rom->isMBC1M())
 {
-  m_is_mbc1m = checkIsMBC1M();
   m_low_banking_bits = 1;
-  if (m_is_mbc1m) {
-    log_info("MBC1M detected");
-  }
 }
 
-bool
-MBC1_Handler::checkIsMBC1M()
+void
+MBC1_Handler::saveState(MBC_State& state) const
 {
-  // all known mbc1m are 1MiB
-  if (((32 * 1024) << m_header->rom_size) != 0x100000) {
-    return false;
-  }
-  // checking  0x00104, 0x40104, 0x80104, and 0xC0104 for multiple logos
-  uint8 logos = 0;
-  for (uint8_t i = 0; i < 4; i++) {
-    header* tmp_header =
-      reinterpret_cast<header*>(m_data + (0x40000 * i) + 0x100);
-    logos +=
-      std::memcmp(NINTENDO_LOGO, tmp_header->logo, sizeof(NINTENDO_LOGO)) == 0;
+  MBC_Handler::saveState(state);
+  state.registers[0] = m_mode;
+  state.registers[1] = m_low_banking_bits;
+  state.registers[2] = m_high_banking_bits;
+}
+
+void
+MBC1_Handler::loadState(const MBC_State& state)
+{
+  MBC_Handler::loadState(state);
+  m_mode = state.registers[0];
+  m_low_banking_bits = state.registers[1];
+  m_high_banking_bits = state.registers[2];
+}
+
+uint16
+MBC1_Handler::romBank(uint16 address) const
+{
+  uint32 bank = 0;
+  if (address >= 0x4000) {
+    bank = m_high_banking_bits << (m_is_mbc1m ? 4 : 5) | m_low_banking_bits;
+  } else if (m_mode == 1) {
+    bank = m_high_banking_bits << (m_is_mbc1m ? 4 : 5);
   }
-  return logos > 1;
+  // banks past the end wrap around like in read_rom
+  return bank % std::max<uint32>(m_rom_size >> 14, 1);
 }
 
 void
 MBC1_Handler::write_rom(uint16 address, uint8 val)
 {
   if (address < 0x2000) {
-    m_enabled_ram = mask_n_bits(4, val) == 0xA;
+    setRamEnabled(mask_n_bits(4, val) == 0xA);
     log_debug("Set m_enable_ram to %d", m_enabled_ram);
     return;
   }
@@ -216,6 +392,7 @@ MBC1_Handler::write_ram(uint16 address, uint8 val)
     tmp_address = mask_n_bits(std::log2(m_ram_size), tmp_address);
   }
   m_ram[tmp_address] = val;
+  m_ram_dirty = true;
 }
 
 uint8
@@ -259,16 +436,33 @@ MBC1_Handler::read_ram(uint16 address)
   return m_ram[tmp_address];
 }
 
-MBC2_Handler::MBC2_Handler(uint8* data, header* header)
-  : MBC_Handler(data, header)
+MBC2_Handler::MBC2_Handler(const RomImage* rom)
+  : MBC_Handler(rom)
 {
   // MBC2 always has a fixed ram size of 512 half bytes
-  m_ram_size = 512;
-  m_ram = std::make_unique<uint8[]>(m_ram_size);
+  initializeRam(512);
   m_banking_bits = 1;
-  if (m_has_battery && m_ram) {
-    load();
-  }
+}
+
+void
+MBC2_Handler::saveState(MBC_State& state) const
+{
+  MBC_Handler::saveState(state);
+  state.registers[0] = m_banking_bits;
+}
+
+void
+MBC2_Handler::loadState(const MBC_State& state)
+{
+  MBC_Handler::loadState(state);
+  m_banking_bits = state.registers[0];
+}
+
+uint16
+MBC2_Handler::romBank(uint16 address) const
+{
+  uint32 bank = address >= 0x4000 ? m_banking_bits : 0;
+  return bank % std::max<uint32>(m_rom_size >> 14, 1);
 }
 
 void
@@ -279,7 +473,7 @@ MBC2_Handler::write_rom(uint16 address, uint8 val)
     m_banking_bits = tmpVal != 0 ? tmpVal : 1;
     log_debug("Set m_banking_bits to 0x%X", m_banking_bits);
   } else {
-    m_enabled_ram = mask_n_bits(4, val) == 0xA;
+    setRamEnabled(mask_n_bits(4, val) == 0xA);
     log_debug("Set m_enable_ram to %d", m_enabled_ram);
   }
 }
@@ -296,6 +490,7 @@ MBC2_Handler::write_ram(uint16 address, uint8 val)
   }
   uint32 tmp_address = mask_n_bits(9, address);
   m_ram[tmp_address] = val;
+  m_ram_dirty = true;
 }
 
 uint8
@@ -1,19 +1,36 @@
 #include "mmu.h"
 #include "common.h"
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
 MMU::MMU(CPU* cpu,
          Cartridge* cartridge,
          PPU* ppu,
          Timer* timer,
          APU* apu,
-         Joypad* joypad)
+         Joypad* joypad,
+         Serial* serial)
   : cpu(cpu)
   , cartridge(cartridge)
   , ppu(ppu)
   , timer(timer)
   , apu(apu)
   , joypad(joypad)
+  , serial(serial)
+{
+}
+
+MMU&
+MMU::operator=(const MMU& other)
 {
+  std::copy(std::begin(other.wram), std::end(other.wram), wram);
+  std::copy(std::begin(other.vram), std::end(other.vram), vram);
+  std::copy(std::begin(other.oam), std::end(other.oam), oam);
+  std::copy(std::begin(other.hram), std::end(other.hram), hram);
+  dma_active = other.dma_active;
+  return *this;
 }
 
 uint8
@@ -159,11 +176,7 @@ MMU::read_io(uint16 addr, Component component)
   } else if (addr >= ApuStart && addr <= ApuEnd) {
     return apu->read(addr);
   } else if (addr >= SerialStart && addr <= SerialEnd) {
-    if (addr == 0xFF02) {
-      return sc;
-    } else {
-      return sb;
-    }
+    return serial->read(addr);
   } else if (addr == IFRAddr) {
     return cpu->IFR | 0xE0;
   } else if (addr == BootRomAddr) {
@@ -189,13 +202,7 @@ MMU::write_io(uint16 addr, uint8 val, Component component)
     apu->write(addr, val);
     return;
   } else if (addr >= SerialStart && addr <= SerialEnd) {
-    if (addr == 0xFF02) {
-      sc = val | 0x7E;
-      log_debug("SC = %X", sc);
-    } else {
-      sb = val;
-      log_debug("SB = %X", sb);
-    }
+    serial->write(addr, val);
     return;
   } else if (addr == IFRAddr) {
     cpu->IFR = val | 0xE0;
@@ -213,6 +220,10 @@ MMU::write_io(uint16 addr, uint8 val, Component component)
 uint8
 MMU::read(uint16 addr, Component component)
 {
+  if (watched_pages != nullptr && watched_pages[addr >> 8] != 0 &&
+      component == Component::CPU) {
+    debugger->onAccess(addr, 0, Debugger::Access::Read);
+  }
   if (addr <= RomEnd) {
     return read_rom(addr, component);
   } else if (addr >= VramStart && addr <= VramEnd) {
@@ -240,9 +251,33 @@ MMU::read(uint16 addr, Component component)
   return 0xFF;
 }
 
+bool
+MMU::copyDmaSource(uint8 page)
+{
+  uint16 source = page << 8;
+  if (source >= VramStart && source <= VramEnd) {
+    std::memcpy(oam, &vram[source - VramStart], OamSize);
+  } else if (source >= WramStart && source <= WramEnd) {
+    std::memcpy(oam, &wram[source - WramStart], OamSize);
+  } else if (source <= RomEnd ||
+             (source >= ExternalRamStart && source <= ExternalRamEnd)) {
+    // banking can't change while the bus is locked
+    for (uint16 i = 0; i < OamSize; i++) {
+      oam[i] = cartridge->read(source + i);
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
 void
 MMU::write(uint16 addr, uint8 val, Component component)
 {
+  if (watched_pages != nullptr && watched_pages[addr >> 8] != 0 &&
+      component == Component::CPU) {
+    debugger->onAccess(addr, val, Debugger::Access::Write);
+  }
   if (addr <= RomEnd) {
     write_rom(addr, val, component);
   } else if (addr >= VramStart && addr <= VramEnd) {
@@ -0,0 +1,149 @@
+#include "movie.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr char Magic[4] = { 'G', 'B', 'M', 'V' };
+constexpr uint32 Version = 3;
+
+void
+writeValue(std::ofstream& file, uint64 value, int bytes)
+{
+  for (int i = 0; i < bytes; i++) {
+    file.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+  }
+}
+
+bool
+readValue(std::ifstream& file, uint64& value, int bytes)
+{
+  value = 0;
+  for (int i = 0; i < bytes; i++) {
+    int c = file.get();
+    if (c == EOF) {
+      return false;
+    }
+    value |= static_cast<uint64>(c) << (i * 8);
+  }
+  return true;
+}
+
+// run lengths as LEB128, most runs fit in a byte or two
+void
+writeVarint(std::ofstream& file, uint64 value)
+{
+  while (value >= 0x80) {
+    file.put(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  file.put(static_cast<char>(value));
+}
+
+bool
+readVarint(std::ifstream& file, uint64& value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = file.get();
+    if (c == EOF) {
+      return false;
+    }
+    value |= static_cast<uint64>(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}
+
+void
+Movie::addFrame(uint8 pressed, uint64 frame_hash)
+{
+  m_buttons.push_back(pressed);
+  m_hashes.push_back(frame_hash);
+}
+
+bool
+Movie::save(const std::string& path) const
+{
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    log_error("Failed to open %s for writing the movie", path.c_str());
+    return false;
+  }
+  file.write(Magic, sizeof(Magic));
+  writeValue(file, Version, 4);
+  writeValue(file, m_rom_hash, 8);
+  writeValue(file, frames(), 8);
+  writeValue(file, m_start_ram.size(), 4);
+  file.write(reinterpret_cast<const char*>(m_start_ram.data()),
+             m_start_ram.size());
+  for (uint64 frame = 0; frame < frames();) {
+    uint64 run = 1;
+    while (frame + run < frames() &&
+           m_buttons[frame + run] == m_buttons[frame]) {
+      run++;
+    }
+    file.put(static_cast<char>(m_buttons[frame]));
+    writeVarint(file, run);
+    frame += run;
+  }
+  for (uint64 hash : m_hashes) {
+    writeValue(file, hash, 8);
+  }
+  return file.good();
+}
+
+bool
+Movie::load(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    log_error("Failed to open movie %s", path.c_str());
+    return false;
+  }
+  char magic[sizeof(Magic)];
+  uint64 version = 0;
+  uint64 frame_count = 0;
+  uint64 ram_size = 0;
+  if (!file.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+      !readValue(file, version, 4) || version != Version) {
+    log_error("%s isn't a movie this emulator can play", path.c_str());
+    return false;
+  }
+  if (!readValue(file, m_rom_hash, 8) || !readValue(file, frame_count, 8) ||
+      !readValue(file, ram_size, 4)) {
+    log_error("Movie %s is truncated", path.c_str());
+    return false;
+  }
+  m_start_ram.resize(ram_size);
+  if (!file.read(reinterpret_cast<char*>(m_start_ram.data()), ram_size)) {
+    log_error("Movie %s is truncated", path.c_str());
+    return false;
+  }
+  m_buttons.clear();
+  m_hashes.clear();
+  while (m_buttons.size() < frame_count) {
+    int pressed = file.get();
+    uint64 run = 0;
+    if (pressed == EOF || !readVarint(file, run) ||
+        run > frame_count - m_buttons.size()) {
+      log_error("Movie %s has a broken input stream", path.c_str());
+      return false;
+    }
+    m_buttons.insert(m_buttons.end(), run, static_cast<uint8>(pressed));
+  }
+  m_hashes.resize(frame_count);
+  for (uint64& hash : m_hashes) {
+    if (!readValue(file, hash, 8)) {
+      log_error("Movie %s is truncated", path.c_str());
+      return false;
+    }
+  }
+  return true;
+}
@@ -1,6 +1,8 @@
 #include "ppu.h"
 #include "mmu.h"
 
+#include <cstring>
+
 PPU::PPU()
 {
   initialize();
@@ -29,6 +31,7 @@ PPU::initialize()
   mode = PpuMode::VBlank;
   dma_state = DMAState::Inactive;
   dma_transferes = 0;
+  dma_copied = false;
   num_of_oam_entries = 0;
   PixelTransferReset();
   wy_internal = 0xFF;
@@ -52,18 +55,24 @@ PPU::tick_dma(uint64 Tcycle)
     return;
   }
   if (dma_state == DMAState::Active) {
-    mmu->setDmaActive(true);
-    uint16 source_addr = (DMA << 8) + dma_transferes;
-    uint16 dest_addr = OamStart + dma_transferes;
-    // read and write should technically be done on separate ticks
-    // but it doesn't really matter for our purposes since nothing else
-    // should access memory during a DMA transfer
-    uint8 data = mmu->read(source_addr, Component::DMA);
-    mmu->write(dest_addr, data, Component::DMA);
+    if (dma_transferes == 0) {
+      mmu->setDmaActive(true);
+      dma_copied = fast_dma && mmu->copyDmaSource(DMA);
+    }
+    if (!dma_copied) {
+      uint16 source_addr = (DMA << 8) + dma_transferes;
+      uint16 dest_addr = OamStart + dma_transferes;
+      // read and write should technically be done on separate ticks
+      // but it doesn't really matter for our purposes since nothing else
+      // should access memory during a DMA transfer
+      uint8 data = mmu->read(source_addr, Component::DMA);
+      mmu->write(dest_addr, data, Component::DMA);
+    }
     dma_transferes++;
     if (dma_transferes >= 0xA0) {
       dma_state = DMAState::Inactive;
       dma_transferes = 0;
+      dma_copied = false;
       // We're technically still active for this tick
       // but it doesn't really matter
       mmu->setDmaActive(false);
@@ -71,6 +80,59 @@ PPU::tick_dma(uint64 Tcycle)
   }
 }
 
+void
+PPU::updateFrameHash()
+{
+  frame_hash = hash64(LCD_SHADES, sizeof(LCD_SHADES));
+}
+
+uint32
+PPU::idleTicks() const
+{
+  if (dma_state != DMAState::Inactive) {
+    return 0;
+  }
+  if ((LCDC & 0x80) == 0) {
+    return UINT32_MAX;
+  }
+  switch (mode) {
+    case PpuMode::HBlank:
+      if (use_turn_on_oam_scan) {
+        return scanline_ticks < 79 ? 79 - scanline_ticks : 0;
+      }
+      // LY changes on tick 454 and the lyc check is back on 455
+      return scanline_ticks < 453 ? 453 - scanline_ticks : 0;
+    case PpuMode::VBlank:
+      if (last_vblank_line) {
+        // LY is reset on tick 2 and the lyc check is back on 3
+        return (scanline_ticks >= 3 && scanline_ticks < 455)
+                 ? 455 - scanline_ticks
+                 : 0;
+      }
+      return scanline_ticks < 453 ? 453 - scanline_ticks : 0;
+    case PpuMode::OamSearch:
+      // oam can't change without dma so the scan can be done in one go
+      return scanline_ticks < 79 ? 79 - scanline_ticks : 0;
+    default:
+      return 0;
+  }
+}
+
+void
+PPU::skipIdleTicks(uint32 ticks)
+{
+  if ((LCDC & 0x80) == 0) {
+    return;
+  }
+  if (mode == PpuMode::OamSearch) {
+    for (uint32 i = 0; i < ticks; i++) {
+      OamSearch();
+    }
+  } else {
+    scanline_ticks += ticks;
+  }
+}
+
 void
 PPU::tick(uint64 Tcycle)
 {
@@ -447,7 +509,7 @@ PPU::PixelTransfer()
       if (palette == &BGP && (LCDC & 0x01) == 0) {
         color_id = 0;
       }
-      LCD_PIXELS[LY * GB_WIDTH + (lx - 8)] = GB_COLORS[color_id];
+      LCD_SHADES[LY * GB_WIDTH + (lx - 8)] = color_id;
     }
 
     pushed_pixel = true;
@@ -490,6 +552,7 @@ PPU::HBlank()
     if (LY >= 144) {
       setMode(PpuMode::VBlank);
       mmu->requestInterrupt(Interrupt::VBlank);
+      updateFrameHash();
     } else {
       setMode(PpuMode::OamSearch);
     }
@@ -655,9 +718,8 @@ PPU::handleLCDCChanges(uint8 old_val)
     for (int i = 0; i < 256; i++) {
       oam_buffer[i].clear();
     }
-    for (int i = 0; i < (GB_HEIGHT * GB_WIDTH); i++) {
-      LCD_PIXELS[i] = GB_COLORS[0];
-    }
+    std::memset(LCD_SHADES, 0, sizeof(LCD_SHADES));
+    updateFrameHash();
   } else {
     log_info("LCDC turned on");
     use_turn_on_oam_scan = true;
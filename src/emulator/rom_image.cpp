@@ -0,0 +1,218 @@
+#include "rom_image.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+struct RegistryEntry
+{
+  std::weak_ptr<const RomImage> image;
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  timespec modified;
+};
+
+// images are only kept alive by the cartridges using them
+std::mutex registry_lock;
+std::unordered_map<std::string, RegistryEntry> images_by_location;
+std::unordered_map<uint64, std::weak_ptr<const RomImage>> images_by_hash;
+
+bool
+isSameFile(const RegistryEntry& entry, const struct stat& file_stat)
+{
+  return entry.device == file_stat.st_dev && entry.inode == file_stat.st_ino &&
+         entry.size == file_stat.st_size &&
+         entry.modified.tv_sec == file_stat.st_mtim.tv_sec &&
+         entry.modified.tv_nsec == file_stat.st_mtim.tv_nsec;
+}
+
+// drops the entries of images no cartridge uses anymore, called under
+// registry_lock so a process cycling through many roms doesn't keep them
+void
+eraseExpired()
+{
+  for (auto it = images_by_location.begin(); it != images_by_location.end();) {
+    if (it->second.image.expired()) {
+      it = images_by_location.erase(it);
+    } else {
+      it++;
+    }
+  }
+  for (auto it = images_by_hash.begin(); it != images_by_hash.end();) {
+    if (it->second.expired()) {
+      it = images_by_hash.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+uint64
+hashData(const uint8* data, uint32 size)
+{
+  // FNV-1a
+  uint64 hash = 0xCBF29CE484222325;
+  for (uint32 i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 0x100000001B3;
+  }
+  return hash;
+}
+
+}
+
+std::shared_ptr<const RomImage>
+RomImage::load(const std::string& location)
+{
+  std::lock_guard<std::mutex> guard(registry_lock);
+  eraseExpired();
+  struct stat file_stat;
+  if (stat(location.c_str(), &file_stat) != 0) {
+    log_error("Failed to open %s", location.c_str());
+    return nullptr;
+  }
+
+  auto location_itr = images_by_location.find(location);
+  if (location_itr != images_by_location.end() &&
+      isSameFile(location_itr->second, file_stat)) {
+    std::shared_ptr<const RomImage> image = location_itr->second.image.lock();
+    if (image) {
+      log_info("Reusing loaded rom image of %s", location.c_str());
+      return image;
+    }
+  }
+
+  // Map the rom read only so instances in other processes running the
+  // same file share the same physical pages as well
+  int fd = open(location.c_str(), O_RDONLY);
+  if (fd < 0) {
+    log_error("Failed to open %s", location.c_str());
+    return nullptr;
+  }
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < 0x150) {
+    log_error("%s is too small to be a cartridge", location.c_str());
+    close(fd);
+    return nullptr;
+  }
+  uint32 size = file_stat.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    log_error("Failed to map %s", location.c_str());
+    return nullptr;
+  }
+  // the mbc handlers map banks by the rom size in the header, a shorter
+  // file would have them read past the end of the mapping
+  uint8 rom_size = static_cast<const uint8*>(data)[0x148];
+  if (rom_size > 8 || size < ((32u * 1024) << rom_size)) {
+    log_error("%s has %u bytes which doesn't match rom size 0x%X",
+              location.c_str(),
+              size,
+              rom_size);
+    munmap(data, size);
+    return nullptr;
+  }
+
+  uint64 hash = hashData(static_cast<const uint8*>(data), size);
+  std::shared_ptr<const RomImage> image;
+  auto hash_itr = images_by_hash.find(hash);
+  if (hash_itr != images_by_hash.end()) {
+    image = hash_itr->second.lock();
+  }
+  if (image && image->size() == size &&
+      std::memcmp(image->data(), data, size) == 0) {
+    log_info("%s has the same content as an already loaded rom",
+             location.c_str());
+    munmap(data, size);
+  } else {
+    image.reset(new RomImage(static_cast<const uint8*>(data), size, hash));
+    images_by_hash[hash] = image;
+  }
+
+  RegistryEntry& entry = images_by_location[location];
+  entry.image = image;
+  entry.device = file_stat.st_dev;
+  entry.inode = file_stat.st_ino;
+  entry.size = file_stat.st_size;
+  entry.modified = file_stat.st_mtim;
+  return image;
+}
+
+RomImage::RomImage(const uint8* data, uint32 size, uint64 hash)
+  : m_data(data)
+  , m_size(size)
+  , m_hash(hash)
+{
+  std::memcpy(&m_header, m_data + 0x100, sizeof(header));
+  // last byte also used to indicate if it supports gmb colour
+  m_header.title[15] = 0;
+  m_valid_header = checkData();
+  m_is_mbc1m = checkIsMBC1M();
+  if (m_is_mbc1m) {
+    log_info("MBC1M detected");
+  }
+}
+
+RomImage::~RomImage()
+{
+  munmap(const_cast<uint8*>(m_data), m_size);
+}
+
+bool
+RomImage::checkData() const
+{
+  bool flag = true;
+  uint8_t checksum = 0;
+
+  if (m_header.ram_size != 0 &&
+      RAM_SIZES.find(m_header.ram_size) == RAM_SIZES.cend()) {
+    log_error("Unknown ram size 0x%X", m_header.ram_size);
+    flag = false;
+  }
+
+  for (uint16_t address = 0x0134; address <= 0x014C; address++) {
+    checksum = checksum - m_data[address] - 1;
+  }
+
+  if (m_header.checksum != checksum) {
+    log_error(
+      "Checksums do not match %d is in the header and %d was calculated",
+      m_header.checksum,
+      checksum);
+    flag = false;
+  }
+
+  if (std::memcmp(NINTENDO_LOGO, m_header.logo, sizeof(NINTENDO_LOGO)) != 0) {
+    log_error("Nintendo logos do not match");
+    flag = false;
+  }
+  return flag;
+}
+
+bool
+RomImage::checkIsMBC1M() const
+{
+  if (m_header.type != MBC1 && m_header.type != MBC1Ram &&
+      m_header.type != MBC1RamB) {
+    return false;
+  }
+  // all known mbc1m are 1MiB
+  if (((32 * 1024) << m_header.rom_size) != 0x100000 || m_size < 0x100000) {
+    return false;
+  }
+  // checking  0x00104, 0x40104, 0x80104, and 0xC0104 for multiple logos
+  uint8 logos = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    const header* tmp_header =
+      reinterpret_cast<const header*>(m_data + (0x40000 * i) + 0x100);
+    logos +=
+      std::memcmp(NINTENDO_LOGO, tmp_header->logo, sizeof(NINTENDO_LOGO)) == 0;
+  }
+  return logos > 1;
+}
@@ -0,0 +1,157 @@
+#include "serial.h"
+#include "link.h"
+#include "mmu.h"
+#include "timer.h"
+
+#include <algorithm>
+
+namespace {
+
+// the internal clock shifts on the falling edge of bit 8 of the system
+// counter, 8192 bits per second
+constexpr uint64 ShiftPeriod = 0x200;
+
+}
+
+SerialFileSink::SerialFileSink(const std::string& path)
+{
+  if (path == "-") {
+    m_file = stdout;
+    return;
+  }
+  m_file = std::fopen(path.c_str(), "wb");
+  if (m_file == nullptr) {
+    log_error("Failed to open %s for serial output", path.c_str());
+  }
+}
+
+SerialFileSink::~SerialFileSink()
+{
+  if (m_file != nullptr && m_file != stdout) {
+    std::fclose(m_file);
+  }
+}
+
+void
+SerialFileSink::receive(uint8 byte)
+{
+  if (m_file == nullptr) {
+    return;
+  }
+  std::fputc(byte, m_file);
+  // test roms print a line at a time, keep it visible while running
+  if (byte == '\n') {
+    std::fflush(m_file);
+  }
+}
+
+uint8
+Serial::read(uint16 addr)
+{
+  catchUp(*clock);
+  if (addr == 0xFF02) {
+    return sc;
+  }
+  if (transfer_end == UINT64_MAX) {
+    return sb;
+  }
+  // ones come in while the outgoing bits are shifted out
+  uint8 bits = shiftedBits();
+  return (outgoing << bits) | ((1 << bits) - 1);
+}
+
+void
+Serial::write(uint16 addr, uint8 val)
+{
+  catchUp(*clock);
+  if (addr == 0xFF02) {
+    sc = val | 0x7E;
+    if ((sc & 0x81) == 0x81) {
+      startTransfer();
+    } else {
+      transfer_end = UINT64_MAX;
+    }
+  } else {
+    sb = val;
+    if (transfer_end != UINT64_MAX) {
+      outgoing = val;
+    }
+  }
+  if (link != nullptr) {
+    link->publish(sb, sc);
+  }
+}
+
+void
+Serial::setLink(LinkPort* link)
+{
+  this->link = link;
+  if (link != nullptr) {
+    link->attach(this);
+    link->publish(sb, sc);
+  }
+}
+
+void
+Serial::receive(uint8 data)
+{
+  if ((sc & 0x81) != 0x80) {
+    // not waiting for the other end, the byte is lost
+    return;
+  }
+  uint8 sent = sb;
+  sb = data;
+  sc &= 0x7F;
+  mmu->requestInterrupt(Interrupt::Serial);
+  sendToSinks(sent);
+  link->publish(sb, sc);
+}
+
+void
+Serial::catchUp(uint64 until)
+{
+  if (until > transfer_end) {
+    finishTransfer();
+  }
+}
+
+void
+Serial::startTransfer()
+{
+  uint16 counter = timer->systemCounter();
+  outgoing = sb;
+  first_shift = *clock + ShiftPeriod - (counter & (ShiftPeriod - 1));
+  transfer_end = first_shift + 7 * ShiftPeriod;
+}
+
+void
+Serial::finishTransfer()
+{
+  transfer_end = UINT64_MAX;
+  sb = link != nullptr ? link->exchange(outgoing) : 0xFF;
+  sc &= 0x7F;
+  mmu->requestInterrupt(Interrupt::Serial);
+  sendToSinks(outgoing);
+  if (link != nullptr) {
+    link->publish(sb, sc);
+  }
+}
+
+void
+Serial::sendToSinks(uint8 byte)
+{
+  if (sinks != nullptr) {
+    for (SerialSink* sink : *sinks) {
+      sink->receive(byte);
+    }
+  }
+}
+
+uint8
+Serial::shiftedBits() const
+{
+  if (*clock < first_shift) {
+    return 0;
+  }
+  return std::min<uint64>(8, (*clock - first_shift) / ShiftPeriod + 1);
+}
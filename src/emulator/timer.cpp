@@ -1,6 +1,15 @@
 #include "timer.h"
+#include "apu.h"
 #include "mmu.h"
 
+#include <algorithm>
+
+namespace {
+
+constexpr uint8 freq_bits[] = { 9, 3, 5, 7 };
+
+}
+
 Timer::Timer()
 {
   initialize();
@@ -15,6 +24,8 @@ Timer::initialize()
   tac = 0xF8;
   prev_bit = false;
   state = State::None;
+  synced = 0;
+  scheduleNextEvent();
 }
 
 uint8
@@ -26,8 +37,10 @@ Timer::read_div() const
 void
 Timer::reset_div()
 {
+  uint16 old_div = div;
   div = 0;
   falling_edge();
+  apu_edge(old_div);
 }
 
 uint8
@@ -89,6 +102,7 @@ Timer::tima_tick()
 void
 Timer::write(uint16 addr, uint8 val)
 {
+  catchUp(*clock);
   switch (addr) {
     case 0xFF04:
       reset_div();
@@ -106,11 +120,13 @@ Timer::write(uint16 addr, uint8 val)
       log_error("Attempted to write to invalid timer address: 0x%04x", addr);
       break;
   }
+  scheduleNextEvent();
 }
 
 uint8
-Timer::read(uint16 addr) const
+Timer::read(uint16 addr)
 {
+  catchUp(*clock);
   switch (addr) {
     case 0xFF04:
       return read_div();
@@ -136,14 +152,92 @@ Timer::M_tick()
   } else if (state == State::Reload) {
     state = State::None;
   }
+  uint16 old_div = div;
   div += 4;
   falling_edge();
+  apu_edge(old_div);
+}
+
+void
+Timer::catchUp(uint64 until)
+{
+  if (until <= synced) {
+    return;
+  }
+  // M-cycles end on clocks 3 mod 4
+  uint64 ticks = until / 4 - synced / 4;
+  synced = until;
+  advance(ticks);
+  scheduleNextEvent();
+}
+
+void
+Timer::advance(uint64 ticks)
+{
+  while (ticks > 0) {
+    if (state != State::None) {
+      M_tick();
+      ticks--;
+      continue;
+    }
+    // only div moves until the tick with the next falling edge
+    uint64 chunk = std::min(ticks, ticksToApuEdge());
+    if (tac & 0x04) {
+      chunk = std::min(chunk, ticksToFallingEdge());
+    }
+    div += 4 * (chunk - 1);
+    falling_edge();
+    M_tick();
+    ticks -= chunk;
+  }
+}
+
+void
+Timer::scheduleNextEvent()
+{
+  uint64 ticks = ticksToApuEdge();
+  if (state == State::Overflow) {
+    ticks = 1;
+  } else if (tac & 0x04) {
+    uint64 period = (2 << freq_bits[tac & 0x03]) / 4;
+    uint64 overflow = ticksToFallingEdge() + (0xFF - tima) * period;
+    // the interrupt is requested on the M-cycle after the overflow
+    ticks = std::min(ticks, overflow + 1);
+  }
+  next_event = (synced | 3) + 4 * (ticks - 1);
+}
+
+uint64
+Timer::nextDivChange()
+{
+  catchUp(*clock);
+  uint64 ticks = (0x100 - (div & 0xFF)) / 4;
+  return (synced | 3) + 4 * (ticks - 1);
+}
+
+uint16
+Timer::systemCounter()
+{
+  catchUp(*clock);
+  return div;
+}
+
+uint64
+Timer::ticksToFallingEdge() const
+{
+  uint16 period = 2 << freq_bits[tac & 0x03];
+  return (period - (div & (period - 1))) / 4;
+}
+
+uint64
+Timer::ticksToApuEdge() const
+{
+  return (0x2000 - (div & 0x1FFF)) / 4;
 }
 
 void
 Timer::falling_edge()
 {
-  constexpr uint8 freq_bits[] = { 9, 3, 5, 7 };
   uint8 bit = freq_bits[tac & 0x03];
   bool current_bit = (div >> bit) & 0x01 && (tac & 0x04);
   if (prev_bit && !current_bit) {
@@ -151,3 +245,12 @@ Timer::falling_edge()
   }
   prev_bit = current_bit;
 }
+
+void
+Timer::apu_edge(uint16 old_div)
+{
+  // the frame sequencer is clocked by bit 4 of DIV falling
+  if (apu && (old_div & ~div & 0x1000)) {
+    apu->divTick();
+  }
+}
@@ -0,0 +1,75 @@
+#include "trace.h"
+
+#include <cstring>
+
+TraceRecorder::TraceRecorder(const std::string& path, uint32 ring_records)
+  : m_path(path)
+  , m_ring(ring_records, WakeInterval)
+{
+  m_file = std::fopen(path.c_str(), "wb");
+  if (m_file == nullptr) {
+    log_error("Failed to open %s for writing the trace", path.c_str());
+    return;
+  }
+  uint32 header[2] = { Version, sizeof(TraceRecord) };
+  std::fwrite(Magic, sizeof(Magic), 1, m_file);
+  std::fwrite(header, sizeof(header), 1, m_file);
+  m_ring.start([this](const TraceRecord* records, uint32 count) {
+    std::fwrite(records, sizeof(TraceRecord), count, m_file);
+  });
+}
+
+TraceRecorder::~TraceRecorder()
+{
+  if (m_file != nullptr) {
+    m_ring.stop();
+    log_info("Wrote %lu trace records to %s, waited for the disk %lu times",
+             recordsWritten(),
+             m_path.c_str(),
+             m_stalls);
+    std::fclose(m_file);
+  }
+}
+
+void
+TraceRecorder::waitForSpace()
+{
+  do {
+    m_stalls++;
+    m_ring.wake();
+    std::this_thread::yield();
+  } while (!m_ring.hasSpace());
+}
+
+TraceReader::TraceReader(const std::string& path)
+{
+  m_file = std::fopen(path.c_str(), "rb");
+  if (m_file == nullptr) {
+    log_error("Failed to open trace %s", path.c_str());
+    return;
+  }
+  char magic[sizeof(TraceRecorder::Magic)];
+  uint32 header[2] = { 0, 0 };
+  if (std::fread(magic, sizeof(magic), 1, m_file) != 1 ||
+      std::memcmp(magic, TraceRecorder::Magic, sizeof(magic)) != 0 ||
+      std::fread(header, sizeof(header), 1, m_file) != 1 ||
+      header[0] != TraceRecorder::Version ||
+      header[1] != sizeof(TraceRecord)) {
+    log_error("%s isn't a trace this build can read", path.c_str());
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+TraceReader::~TraceReader()
+{
+  if (m_file != nullptr) {
+    std::fclose(m_file);
+  }
+}
+
+bool
+TraceReader::read(TraceRecord& record)
+{
+  return std::fread(&record, sizeof(record), 1, m_file) == 1;
+}
@@ -0,0 +1,180 @@
+#include "vec_emulator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+
+VecEmulator::VecEmulator(std::string file, uint32 num_envs, uint32 num_threads)
+  : m_num_envs(num_envs)
+  , m_buttons(num_envs, 0)
+{
+  log_info("Creating %u emulators with %s", num_envs, file.c_str());
+  // emulators aren't movable so they are constructed in place
+  std::allocator<Emulator> allocator;
+  m_envs = allocator.allocate(m_num_envs);
+  for (uint32 i = 0; i < m_num_envs; i++) {
+    new (&m_envs[i]) Emulator(file);
+    // resets and snapshots would otherwise end up in the player's save
+    m_envs[i].setSavesEnabled(false);
+  }
+  if (isValid()) {
+    m_envs[0].saveSnapshot(m_initial_snapshot);
+  }
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, std::max(1u, m_num_envs));
+  // the thread calling step does work as well
+  for (uint32 i = 1; i < num_threads; i++) {
+    m_workers.emplace_back(&VecEmulator::workerLoop, this);
+  }
+}
+
+VecEmulator::~VecEmulator()
+{
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stop = true;
+  }
+  m_work_cv.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+  for (uint32 i = 0; i < m_num_envs; i++) {
+    m_envs[i].~Emulator();
+  }
+  std::allocator<Emulator> allocator;
+  allocator.deallocate(m_envs, m_num_envs);
+}
+
+bool
+VecEmulator::isValid()
+{
+  for (uint32 i = 0; i < m_num_envs; i++) {
+    if (!m_envs[i].isValid()) {
+      return false;
+    }
+  }
+  return m_num_envs > 0;
+}
+
+uint32
+VecEmulator::observationSize(ObservationFormat format)
+{
+  uint32 pixels = GB_WIDTH * GB_HEIGHT;
+  return format == ObservationFormat::ARGB ? pixels * sizeof(uint32) : pixels;
+}
+
+void
+VecEmulator::setWatchedAddresses(const std::vector<uint16>& addresses)
+{
+  m_watched_addresses = addresses;
+}
+
+void
+VecEmulator::setPressedButtons(uint32 env, uint8 pressed)
+{
+  m_buttons[env] = pressed;
+}
+
+void
+VecEmulator::step(uint32 frames,
+                  uint8* observations,
+                  ObservationFormat format,
+                  uint8* ram)
+{
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_frames = frames;
+    m_observations = observations;
+    m_format = format;
+    m_ram = ram;
+    m_remaining = m_num_envs;
+    m_next_env = 0;
+    m_generation++;
+  }
+  m_work_cv.notify_all();
+
+  runJobs();
+
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_done_cv.wait(lock, [this] { return m_remaining == 0; });
+}
+
+void
+VecEmulator::saveSnapshot(uint32 env, EmulatorSnapshot& snapshot) const
+{
+  m_envs[env].saveSnapshot(snapshot);
+}
+
+void
+VecEmulator::loadSnapshot(uint32 env, const EmulatorSnapshot& snapshot)
+{
+  m_envs[env].loadSnapshot(snapshot);
+}
+
+void
+VecEmulator::reset(uint32 env)
+{
+  m_envs[env].loadSnapshot(m_initial_snapshot);
+  m_buttons[env] = 0;
+}
+
+void
+VecEmulator::workerLoop()
+{
+  uint64 seen_generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_work_cv.wait(lock, [this, seen_generation] {
+        return m_stop || m_generation != seen_generation;
+      });
+      if (m_stop) {
+        return;
+      }
+      seen_generation = m_generation;
+    }
+    runJobs();
+  }
+}
+
+void
+VecEmulator::runJobs()
+{
+  uint32 env;
+  while ((env = m_next_env.fetch_add(1)) < m_num_envs) {
+    stepEnv(env);
+    if (m_remaining.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_done_cv.notify_all();
+    }
+  }
+}
+
+void
+VecEmulator::stepEnv(uint32 env)
+{
+  Emulator& emulator = m_envs[env];
+  emulator.setPressedButtons(m_buttons[env]);
+  for (uint32 i = 0; i < m_frames; i++) {
+    emulator.cycleFrame();
+  }
+
+  uint8* observation = m_observations + env * observationSize(m_format);
+  if (m_format == ObservationFormat::ARGB) {
+    std::memcpy(
+      observation, emulator.getFramebuffer(), observationSize(m_format));
+  } else {
+    std::memcpy(observation, emulator.getShades(), observationSize(m_format));
+  }
+
+  if (m_ram != nullptr) {
+    uint8* ram = m_ram + env * m_watched_addresses.size();
+    for (size_t i = 0; i < m_watched_addresses.size(); i++) {
+      ram[i] = emulator.peek(m_watched_addresses[i]);
+    }
+  }
+}
@@ -0,0 +1,159 @@
+#include "video.h"
+
+#include <cstring>
+
+namespace {
+
+bool
+endsWith(const std::string& text, const std::string& suffix)
+{
+  return text.size() >= suffix.size() &&
+         text.compare(text.size() - suffix.size(), suffix.size(), suffix) ==
+           0;
+}
+
+// 4194304 / 70224 reduced
+constexpr uint32 FpsNumerator = 262144;
+constexpr uint32 FpsDenominator = 4389;
+
+}
+
+VideoRecorder::VideoRecorder(const std::string& path,
+                             const Palette& palette,
+                             uint32 ring_frames)
+  : m_file(path, std::ios::binary | std::ios::trunc)
+  , m_path(path)
+  , m_palette(palette)
+  // frames are big, each one goes back to the emulator once it is written
+  , m_ring(ring_frames, 1, 1)
+{
+  if (!m_file.is_open()) {
+    log_error("Failed to open %s for writing video", path.c_str());
+    return;
+  }
+  if (endsWith(path, ".y4m")) {
+    m_format = Format::Y4M;
+    m_file << "YUV4MPEG2 W" << GB_WIDTH << " H" << GB_HEIGHT << " F"
+           << FpsNumerator << ":" << FpsDenominator << " Ip A1:1 C444\n";
+  } else if (endsWith(path, ".gbv")) {
+    m_format = Format::Delta;
+    m_file.write("GBVD", 4);
+    for (uint32 value : { GB_WIDTH, GB_HEIGHT }) {
+      m_file.put(static_cast<char>(value & 0xFF));
+      m_file.put(static_cast<char>(value >> 8));
+    }
+    // no real frame has a transparent pixel, the first one is sent whole
+    m_previous.assign(FrameSize, 0);
+  }
+  m_pixels.resize(FrameSize);
+  m_output.reserve(FrameSize * 4);
+  m_ring.start([this](const Frame* frames, uint32 count) {
+    for (uint32 i = 0; i < count; i++) {
+      writeFrame(frames[i].data());
+    }
+  });
+}
+
+VideoRecorder::~VideoRecorder()
+{
+  if (!m_file.is_open()) {
+    return;
+  }
+  m_ring.stop();
+  log_info("Wrote %lu frames of video to %s, dropped %lu",
+           framesWritten(),
+           m_path.c_str(),
+           framesDropped());
+}
+
+void
+VideoRecorder::pushFrame(const uint8* shades)
+{
+  if (!m_ring.hasSpace()) {
+    m_dropped++;
+    return;
+  }
+  std::memcpy(m_ring.next().data(), shades, FrameSize);
+  m_ring.push();
+}
+
+void
+VideoRecorder::writeFrame(const uint8* shades)
+{
+  shadesToArgb(shades, m_pixels.data(), FrameSize, m_palette);
+  const uint32* pixels = m_pixels.data();
+  m_output.clear();
+  switch (m_format) {
+    case Format::Raw:
+      for (uint32 i = 0; i < FrameSize; i++) {
+        m_output.push_back((pixels[i] >> 16) & 0xFF);
+        m_output.push_back((pixels[i] >> 8) & 0xFF);
+        m_output.push_back(pixels[i] & 0xFF);
+      }
+      break;
+    case Format::Y4M:
+      writeY4M(pixels);
+      break;
+    case Format::Delta:
+      writeDelta(pixels);
+      break;
+  }
+  m_file.write(reinterpret_cast<const char*>(m_output.data()),
+               m_output.size());
+}
+
+void
+VideoRecorder::writeY4M(const uint32* pixels)
+{
+  static const char Header[] = "FRAME\n";
+  m_output.insert(m_output.end(), Header, Header + sizeof(Header) - 1);
+  size_t planes = m_output.size();
+  m_output.resize(planes + FrameSize * 3);
+  uint8* y = &m_output[planes];
+  uint8* u = y + FrameSize;
+  uint8* v = u + FrameSize;
+  // bt.601 studio range
+  for (uint32 i = 0; i < FrameSize; i++) {
+    int32 r = (pixels[i] >> 16) & 0xFF;
+    int32 g = (pixels[i] >> 8) & 0xFF;
+    int32 b = pixels[i] & 0xFF;
+    y[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    u[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    v[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+  }
+}
+
+void
+VideoRecorder::writeDelta(const uint32* pixels)
+{
+  uint32 i = 0;
+  while (i < FrameSize) {
+    uint32 same = i;
+    while (same < FrameSize && pixels[same] == m_previous[same]) {
+      same++;
+    }
+    uint32 changed = same;
+    while (changed < FrameSize && pixels[changed] != m_previous[changed]) {
+      changed++;
+    }
+    writeVarint(same - i);
+    writeVarint(changed - same);
+    for (uint32 j = same; j < changed; j++) {
+      m_output.push_back((pixels[j] >> 16) & 0xFF);
+      m_output.push_back((pixels[j] >> 8) & 0xFF);
+      m_output.push_back(pixels[j] & 0xFF);
+    }
+    i = changed;
+  }
+  std::memcpy(m_previous.data(), pixels, FrameSize * sizeof(uint32));
+}
+
+void
+VideoRecorder::writeVarint(uint32 value)
+{
+  while (value >= 0x80) {
+    m_output.push_back((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  m_output.push_back(value);
+}
@@ -8,13 +8,145 @@ main(int argc, char* argv[])
   // MainWindow w;
   // w.show();
   // return a.exec();
-  if (argc < 2) {
-    log_error("No ROM file provided. Usage: %s <rom_file>", argv[0]);
+  std::string file;
+  bool audio_sync = false;
+  bool idle_loop_detection = true;
+  bool block_caching = true;
+  bool verify_flags = false;
+  bool fast_oam_dma = true;
+  uint64 headless_frames = 0;
+  std::string audio_file;
+  uint32 sample_rate = 48000;
+  std::string serial_file;
+  bool stop_on_result = false;
+  std::string record_file;
+  std::string replay_file;
+  std::string video_file;
+  const Palette* palette = nullptr;
+  bool debug = false;
+  std::string trace_file;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--save-dir" && i + 1 < argc) {
+      Cartridge::setSaveDirectory(argv[++i]);
+    } else if (arg == "--audio-sync") {
+      audio_sync = true;
+    } else if (arg == "--no-idle-skip") {
+      idle_loop_detection = false;
+    } else if (arg == "--no-block-cache") {
+      block_caching = false;
+    } else if (arg == "--verify-flags") {
+      verify_flags = true;
+    } else if (arg == "--no-fast-dma") {
+      fast_oam_dma = false;
+    } else if (arg == "--headless" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], 10, headless_frames) ||
+          headless_frames == 0) {
+        log_error("Invalid frame count %s", argv[i]);
+        return 1;
+      }
+    } else if (arg == "--audio-out" && i + 1 < argc) {
+      audio_file = argv[++i];
+    } else if (arg == "--sample-rate" && i + 1 < argc) {
+      uint64 rate = 0;
+      if (!parseNumber(argv[++i], 10, rate) || rate < MinSampleRate ||
+          rate > MaxSampleRate) {
+        log_error("Invalid sample rate %s, expected %u to %u",
+                  argv[i],
+                  MinSampleRate,
+                  MaxSampleRate);
+        return 1;
+      }
+      sample_rate = rate;
+    } else if (arg == "--serial-out" && i + 1 < argc) {
+      serial_file = argv[++i];
+    } else if (arg == "--stop-on-result") {
+      stop_on_result = true;
+    } else if (arg == "--record" && i + 1 < argc) {
+      record_file = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replay_file = argv[++i];
+    } else if (arg == "--video-out" && i + 1 < argc) {
+      video_file = argv[++i];
+    } else if (arg == "--trace" && i + 1 < argc) {
+      trace_file = argv[++i];
+    } else if (arg == "--log-file" && i + 1 < argc) {
+      Logger::getInstance().setFile(argv[++i]);
+    } else if (arg == "--debug") {
+      debug = true;
+    } else if (arg == "--palette" && i + 1 < argc) {
+      palette = findPalette(argv[++i]);
+      if (palette == nullptr) {
+        log_error("Unknown palette %s, pick green, gray or pocket", argv[i]);
+        return 1;
+      }
+    } else {
+      file = arg;
+    }
+  }
+  if (file.empty()) {
+    log_error("No ROM file provided. Usage: %s [--save-dir <dir>] "
+              "[--audio-sync] [--no-idle-skip] [--no-block-cache] "
+              "[--verify-flags] [--no-fast-dma] "
+              "[--headless <frames> [--audio-out <file>] "
+              "[--sample-rate <hz>] [--stop-on-result]] "
+              "[--serial-out <file or ->] [--record <movie>] "
+              "[--replay <movie>] [--video-out <file>] "
+              "[--palette <green|gray|pocket>] [--debug] [--trace <file>] "
+              "[--log-file <file>] <rom_file>",
+              argv[0]);
     return 1;
   }
-  std::string file = argv[1];
   std::unique_ptr<Emulator> m_emulator = std::make_unique<Emulator>(file);
-  if (m_emulator->isValid()) {
+  if (!m_emulator->isValid()) {
+    return 0;
+  }
+  m_emulator->setIdleLoopDetection(idle_loop_detection);
+  m_emulator->setBlockCaching(block_caching);
+  m_emulator->setFlagVerification(verify_flags);
+  m_emulator->setFastOamDma(fast_oam_dma);
+  if (palette != nullptr) {
+    m_emulator->setPalette(*palette);
+  }
+  if (debug) {
+    // the console opens before the first instruction
+    m_emulator->enableDebugger()->requestBreak();
+  }
+  std::unique_ptr<SerialFileSink> serial_sink;
+  if (!serial_file.empty()) {
+    serial_sink = std::make_unique<SerialFileSink>(serial_file);
+    if (!serial_sink->isOpen()) {
+      return 1;
+    }
+    m_emulator->addSerialSink(serial_sink.get());
+  }
+  if (!trace_file.empty() && !m_emulator->recordTrace(trace_file)) {
+    return 1;
+  }
+  if (!video_file.empty() && !m_emulator->recordVideo(video_file)) {
+    return 1;
+  }
+  if (!replay_file.empty()) {
+    Movie movie;
+    if (!movie.load(replay_file) || !m_emulator->replayMovie(movie)) {
+      return 1;
+    }
+  } else if (headless_frames > 0) {
+    if (!audio_file.empty() &&
+        !m_emulator->recordAudio(audio_file, sample_rate)) {
+      return 1;
+    }
+    TestResult result =
+      m_emulator->runHeadless(headless_frames, stop_on_result);
+    if (stop_on_result) {
+      // exit code for scripts, no result counts as a failure
+      return result == TestResult::Passed ? 0 : 1;
+    }
+  } else {
+    if (!record_file.empty()) {
+      m_emulator->recordMovie(record_file);
+    }
+    m_emulator->setAudioSync(audio_sync);
     m_emulator->mainLoop();
   }
   return 0;
@@ -0,0 +1,231 @@
+#include "emulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Runs every rom of a golden file headless and compares the frame hash at
+// the listed frames. Each line of the golden file is
+//   <rom path relative to the golden file> <frame> <hash in hex>
+// with # starting a comment. A rom stops at its last checkpoint or at the
+// first one that doesn't match.
+
+namespace {
+
+struct Checkpoint
+{
+  uint64 frame;
+  uint64 hash;
+};
+
+struct RomJob
+{
+  std::string name;
+  std::string path;
+  std::vector<Checkpoint> checkpoints;
+  // filled by the worker
+  bool loaded = false;
+  bool passed = false;
+  uint64 failed_frame = 0;
+  uint64 expected = 0;
+  uint64 actual = 0;
+  std::vector<uint64> hashes;
+  double seconds = 0;
+};
+
+bool
+parseGolden(const std::string& path, std::vector<RomJob>& jobs)
+{
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    log_error("Failed to open golden file %s", path.c_str());
+    return false;
+  }
+  std::string directory = ".";
+  size_t slash = path.find_last_of('/');
+  if (slash != std::string::npos) {
+    directory = path.substr(0, slash);
+  }
+  std::map<std::string, size_t> job_index;
+  std::string line;
+  for (uint32 line_number = 1; std::getline(file, line); line_number++) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string rom;
+    std::string hash;
+    Checkpoint checkpoint;
+    if (!(fields >> rom)) {
+      continue;
+    }
+    if (!(fields >> checkpoint.frame >> hash) || checkpoint.frame == 0) {
+      log_error("%s:%u: expected <rom> <frame> <hash>", path.c_str(),
+                line_number);
+      return false;
+    }
+    if (!parseNumber(hash.c_str(), 16, checkpoint.hash)) {
+      log_error("%s:%u: invalid hash %s", path.c_str(), line_number,
+                hash.c_str());
+      return false;
+    }
+    auto itr = job_index.find(rom);
+    if (itr == job_index.end()) {
+      itr = job_index.emplace(rom, jobs.size()).first;
+      jobs.push_back({});
+      jobs.back().name = rom;
+      jobs.back().path = rom[0] == '/' ? rom : directory + "/" + rom;
+    }
+    jobs[itr->second].checkpoints.push_back(checkpoint);
+  }
+  for (RomJob& job : jobs) {
+    std::sort(job.checkpoints.begin(),
+              job.checkpoints.end(),
+              [](const Checkpoint& a, const Checkpoint& b) {
+                return a.frame < b.frame;
+              });
+  }
+  return true;
+}
+
+void
+runJob(RomJob& job, bool update)
+{
+  auto start = std::chrono::steady_clock::now();
+  Emulator emulator(job.path);
+  if (!emulator.isValid()) {
+    return;
+  }
+  job.loaded = true;
+  job.passed = true;
+  uint64 frame = 0;
+  for (const Checkpoint& checkpoint : job.checkpoints) {
+    while (frame < checkpoint.frame) {
+      emulator.cycleFrame();
+      frame++;
+    }
+    uint64 hash = emulator.frameHash();
+    job.hashes.push_back(hash);
+    if (!update && hash != checkpoint.hash) {
+      job.passed = false;
+      job.failed_frame = checkpoint.frame;
+      job.expected = checkpoint.hash;
+      job.actual = hash;
+      break;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  job.seconds = elapsed.count();
+}
+
+bool
+writeGolden(const std::string& path, const std::vector<RomJob>& jobs)
+{
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    log_error("Failed to open golden file %s for writing", path.c_str());
+    return false;
+  }
+  file << "# rom frame hash\n";
+  for (const RomJob& job : jobs) {
+    for (size_t i = 0; i < job.hashes.size(); i++) {
+      char hash[17];
+      std::snprintf(hash, sizeof(hash), "%016llx",
+                    (unsigned long long)job.hashes[i]);
+      file << job.name << " " << job.checkpoints[i].frame << " " << hash
+           << "\n";
+    }
+  }
+  return file.good();
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+  std::string golden;
+  uint32 jobs_count = std::max(1u, std::thread::hardware_concurrency());
+  bool update = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--jobs" && i + 1 < argc) {
+      uint64 value = 0;
+      if (!parseNumber(argv[++i], 10, value) || value == 0 ||
+          value > 1024) {
+        log_error("Invalid job count %s", argv[i]);
+        return 1;
+      }
+      jobs_count = value;
+    } else if (arg == "--update") {
+      update = true;
+    } else {
+      golden = arg;
+    }
+  }
+  if (golden.empty()) {
+    log_error("No golden file provided. Usage: %s [--jobs <n>] [--update] "
+              "<golden_file>",
+              argv[0]);
+    return 1;
+  }
+  std::vector<RomJob> jobs;
+  if (!parseGolden(golden, jobs)) {
+    return 1;
+  }
+  // runs have to be reproducible, whatever saves lie around
+  Cartridge::setSaveDirectory("");
+
+  // the longest roms go first so they don't end up running alone
+  std::vector<RomJob*> order;
+  for (RomJob& job : jobs) {
+    order.push_back(&job);
+  }
+  std::sort(order.begin(), order.end(), [](RomJob* a, RomJob* b) {
+    return a->checkpoints.back().frame > b->checkpoints.back().frame;
+  });
+  std::atomic<size_t> next{ 0 };
+  std::vector<std::thread> workers;
+  for (uint32 i = 0; i < std::min<size_t>(jobs_count, jobs.size()); i++) {
+    workers.emplace_back([&]() {
+      for (size_t job = next++; job < order.size(); job = next++) {
+        runJob(*order[job], update);
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  uint32 failures = 0;
+  for (const RomJob& job : jobs) {
+    if (!job.loaded) {
+      std::printf("ERROR %s couldn't be loaded\n", job.name.c_str());
+      failures++;
+    } else if (!job.passed) {
+      std::printf("FAIL  %s frame %lu expected %016lx got %016lx\n",
+                  job.name.c_str(),
+                  job.failed_frame,
+                  job.expected,
+                  job.actual);
+      failures++;
+    } else {
+      uint64 frames = job.checkpoints.back().frame;
+      std::printf("%s %s %lu frames in %.2fs\n",
+                  update ? "DONE " : "PASS ",
+                  job.name.c_str(),
+                  frames,
+                  job.seconds);
+    }
+  }
+  std::printf("%zu roms, %u failed\n", jobs.size(), failures);
+  if (update && failures == 0 && !writeGolden(golden, jobs)) {
+    return 1;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#include "trace.h"
+
+#include <cstdio>
+
+// Prints a binary trace written with --trace in the Gameboy Doctor format,
+// with --cycles every line starts with the T-cycle of the instruction
+int
+main(int argc, char* argv[])
+{
+  std::string path;
+  bool cycles = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--cycles") {
+      cycles = true;
+    } else {
+      path = arg;
+    }
+  }
+  if (path.empty()) {
+    log_error("No trace file provided. Usage: %s [--cycles] <trace_file>",
+              argv[0]);
+    return 1;
+  }
+  TraceReader reader(path);
+  if (!reader.isOpen()) {
+    return 1;
+  }
+  TraceRecord r;
+  while (reader.read(r)) {
+    if (cycles) {
+      std::printf("%lu ", r.cycle);
+    }
+    std::printf("A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X "
+                "SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X\n",
+                r.a,
+                r.f,
+                r.b,
+                r.c,
+                r.d,
+                r.e,
+                r.h,
+                r.l,
+                r.sp,
+                r.pc,
+                r.mem[0],
+                r.mem[1],
+                r.mem[2],
+                r.mem[3]);
+  }
+  return 0;
+}